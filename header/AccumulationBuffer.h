@@ -0,0 +1,136 @@
+#pragma once
+
+#include <AlignedAllocator.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+namespace RT {
+
+    // Storage for the per-pixel radiance estimate, 8, 16 or 32 bytes per pixel
+    enum class AccumulationPrecision {
+        Half,       // Running mean in half floats, for very large images. Stops improving past a few thousand samples.
+        Float,      // Running sum in floats
+        Double      // Running sum in doubles, for final renders with many thousands of samples
+    };
+
+    /*
+     *  Accumulated radiance of every pixel. Each pixel takes four channels in every mode so rows stay aligned for
+     *  SIMD loads. Half precision keeps the mean instead of the sum, a sum would run out of range and precision after
+     *  a few hundred samples. Different threads may add samples concurrently as long as they touch different pixels.
+    */
+    class AccumulationBuffer {
+    public:
+        void Resize(uint32_t pixelCount);
+        void SetPrecision(AccumulationPrecision precision);
+        AccumulationPrecision GetPrecision() const { return mPrecision; }
+        void Clear();
+
+        // sampleCount includes the sample being added
+        void AddSample(uint32_t pixelIndex, const glm::vec3& color, uint32_t sampleCount) {
+            switch (mPrecision) {
+            case AccumulationPrecision::Half: {
+                uint16_t* pixel = &mHalf[pixelIndex * 4];
+                float weight = 1.0f / static_cast<float>(sampleCount);
+                for (int c = 0; c < 3; c++) {
+                    float mean = HalfToFloat(pixel[c]);
+                    pixel[c] = FloatToHalf(std::min(mean + (color[c] - mean) * weight, MaxHalf));
+                }
+                break;
+            }
+            case AccumulationPrecision::Float:
+                mFloat[pixelIndex] += glm::vec4(color, 0.0f);
+                break;
+            case AccumulationPrecision::Double: {
+                double* pixel = &mDouble[pixelIndex * 4];
+                pixel[0] += color.r;
+                pixel[1] += color.g;
+                pixel[2] += color.b;
+                break;
+            }
+            }
+        }
+
+        // Replaces the pixel's samples with sampleCount samples of the given mean, 0 empties the pixel
+        void SetMean(uint32_t pixelIndex, const glm::vec3& mean, uint32_t sampleCount) {
+            switch (mPrecision) {
+            case AccumulationPrecision::Half: {
+                uint16_t* pixel = &mHalf[pixelIndex * 4];
+                for (int c = 0; c < 3; c++)
+                    pixel[c] = FloatToHalf(sampleCount > 0 ? std::min(mean[c], MaxHalf) : 0.0f);
+                break;
+            }
+            case AccumulationPrecision::Float:
+                mFloat[pixelIndex] = glm::vec4(mean * static_cast<float>(sampleCount), 0.0f);
+                break;
+            case AccumulationPrecision::Double: {
+                double* pixel = &mDouble[pixelIndex * 4];
+                for (int c = 0; c < 3; c++)
+                    pixel[c] = static_cast<double>(mean[c]) * sampleCount;
+                break;
+            }
+            }
+        }
+
+        glm::vec3 GetMean(uint32_t pixelIndex, uint32_t sampleCount) const {
+            switch (mPrecision) {
+            case AccumulationPrecision::Half: {
+                const uint16_t* pixel = &mHalf[pixelIndex * 4];
+                return glm::vec3(HalfToFloat(pixel[0]), HalfToFloat(pixel[1]), HalfToFloat(pixel[2]));
+            }
+            case AccumulationPrecision::Float:
+                return glm::vec3(mFloat[pixelIndex]) / static_cast<float>(sampleCount);
+            case AccumulationPrecision::Double: {
+                const double* pixel = &mDouble[pixelIndex * 4];
+                double n = static_cast<double>(sampleCount);
+                return glm::vec3(static_cast<float>(pixel[0] / n), static_cast<float>(pixel[1] / n), static_cast<float>(pixel[2] / n));
+            }
+            }
+            return glm::vec3(0.0f);
+        }
+
+        size_t GetMemoryUsage() const;
+
+        // IEEE 754 binary16 conversion, rounding to nearest even
+        static uint16_t FloatToHalf(float value) {
+            uint32_t bits = std::bit_cast<uint32_t>(value);
+            uint32_t sign = (bits >> 16) & 0x8000u;
+            bits &= 0x7fffffffu;
+            if (bits >= 0x47800000u)                    // Too large for a half, or inf/nan
+                return static_cast<uint16_t>(sign | (bits > 0x7f800000u ? 0x7e00u : 0x7c00u));
+            if (bits < 0x38800000u) {                   // Subnormal half, let the float adder do the rounding
+                float rounded = std::bit_cast<float>(bits) + 0.5f;
+                return static_cast<uint16_t>(sign | (std::bit_cast<uint32_t>(rounded) - 0x3f000000u));
+            }
+            uint32_t mantissaOdd = (bits >> 13) & 1u;
+            bits += 0xc8000fffu + mantissaOdd;          // Rebias the exponent and round
+            return static_cast<uint16_t>(sign | (bits >> 13));
+        }
+
+        static float HalfToFloat(uint16_t value) {
+            uint32_t bits = static_cast<uint32_t>(value & 0x7fffu) << 13;
+            uint32_t exponent = bits & 0x0f800000u;
+            bits += 0x38000000u;
+            if (exponent == 0x0f800000u) {              // Inf/nan
+                bits += 0x38000000u;
+            } else if (exponent == 0) {                 // Zero or subnormal, renormalize
+                bits += 0x00800000u;
+                bits = std::bit_cast<uint32_t>(std::bit_cast<float>(bits) - std::bit_cast<float>(0x38800000u));
+            }
+            return std::bit_cast<float>(bits | (static_cast<uint32_t>(value & 0x8000u) << 16));
+        }
+
+    private:
+        static constexpr float MaxHalf = 65504.0f;
+
+        AccumulationPrecision mPrecision = AccumulationPrecision::Float;
+        uint32_t mPixelCount = 0;
+        Core::AlignedVector<uint16_t> mHalf;
+        Core::AlignedVector<glm::vec4> mFloat;
+        Core::AlignedVector<double> mDouble;
+    };
+
+}
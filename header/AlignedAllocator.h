@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace Core {
+
+    // std::vector allocator that aligns its storage so SIMD code can use aligned loads
+    template <typename T, size_t Alignment = 32>
+    struct AlignedAllocator {
+        using value_type = T;
+
+        template <typename U>
+        struct rebind {
+            using other = AlignedAllocator<U, Alignment>;
+        };
+
+        AlignedAllocator() = default;
+        template <typename U>
+        AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+        T* allocate(size_t n) {
+            return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+        }
+
+        void deallocate(T* ptr, size_t) {
+            ::operator delete(ptr, std::align_val_t(Alignment));
+        }
+
+        template <typename U>
+        bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+        template <typename U>
+        bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+    };
+
+    template <typename T, size_t Alignment = 32>
+    using AlignedVector = std::vector<T, AlignedAllocator<T, Alignment>>;
+
+}
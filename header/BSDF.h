@@ -0,0 +1,51 @@
+#pragma once
+
+#include <Scene.h>
+
+#include <glm/glm.hpp>
+
+namespace RT {
+
+    struct BSDFSample {
+        glm::vec3 direction;    // World space, pointing away from the surface
+        glm::vec3 weight;       // BSDF times cosine over pdf, what the path throughput gets multiplied with
+        float pdf;              // Solid angle density, 0 for the mirror lobe which light sampling can't reach
+    };
+
+    /*
+     *  Reflection of a material at one shading point: a Lambertian lobe with weight 1 - shininess and a GGX lobe with
+     *  weight shininess, both tinted by the albedo. The GGX roughness is (1 - shininess)^2, so very shiny materials
+     *  end up as a perfect mirror. Directions are passed in world space and pointing away from the surface.
+     *  Sampling picks one lobe and returns the weight of the whole BSDF over the combined density of both, which
+     *  keeps the variance low where the lobes overlap.
+    */
+    class BSDF {
+    public:
+        BSDF(const Core::Material& material, const glm::vec3& normal);
+
+        // False when the sampled direction ends up below the surface, the path has to end there
+        bool Sample(const glm::vec3& wo, float uLobe, float u0, float u1, BSDFSample& sample) const;
+
+        // BSDF times cosine for a pair of directions, mirror reflection excluded. pdf is the density Sample produces
+        // wi with, for weighting light samples against it.
+        glm::vec3 Evaluate(const glm::vec3& wo, const glm::vec3& wi, float& pdf) const;
+
+        // Whether anything but perfect mirror reflection is left, only then light samples can contribute
+        bool HasNonSpecular() const { return mDiffuseWeight > 0.0f || !mMirror; }
+
+    private:
+        glm::vec3 ToLocal(const glm::vec3& v) const;
+        glm::vec3 ToWorld(const glm::vec3& v) const;
+        // Local space BSDF value (times cosine) and density of both lobes
+        void EvaluateLocal(const glm::vec3& wo, const glm::vec3& wi, glm::vec3& value, float& pdf) const;
+
+    private:
+        glm::vec3 mNormal, mTangent, mBitangent;
+        glm::vec3 mAlbedo;
+        float mDiffuseWeight;
+        float mSpecularWeight;
+        float mAlpha;           // GGX roughness
+        bool mMirror;           // Roughness is low enough to treat the GGX lobe as a delta
+    };
+
+}
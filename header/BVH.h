@@ -0,0 +1,148 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+#include <cfloat>
+#include <utility>
+
+namespace RT {
+
+    struct AABB {
+        glm::vec3 min{FLT_MAX};
+        glm::vec3 max{-FLT_MAX};
+
+        void Grow(const glm::vec3& point) { min = glm::min(min, point); max = glm::max(max, point); }
+        void Grow(const AABB& box) { min = glm::min(min, box.min); max = glm::max(max, box.max); }
+        glm::vec3 Center() const { return (min + max) * 0.5f; }
+        float SurfaceArea() const {
+            glm::vec3 e = max - min;
+            if (e.x < 0 || e.y < 0 || e.z < 0)
+                return 0.0f;
+            return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+        }
+    };
+
+    // 32 bytes so two nodes share a cache line. Interior nodes store their left child in leftFirst and the right child is
+    // always leftFirst + 1, leaves store the first index into the primitive list and a non zero primCount.
+    struct BVHNode {
+        glm::vec3 boundsMin;
+        uint32_t leftFirst = 0;
+        glm::vec3 boundsMax;
+        uint32_t primCount = 0;
+
+        bool IsLeaf() const { return primCount > 0; }
+    };
+
+    class BVH {
+    public:
+        static constexpr int StackSize = 64;
+
+        // Builds a binned SAH tree over the given primitive bounds. Primitives are referenced by their index in primBounds.
+        void Build(const std::vector<AABB>& primBounds);
+        void Clear();
+
+        // Recomputes the bounds of the leaves holding the given primitives and of their ancestors, leaving the topology alone.
+        // primBounds must already contain the new bounds and still have the same size as the one the tree was built from.
+        void Refit(const std::vector<uint32_t>& dirtyPrims, const std::vector<AABB>& primBounds);
+
+        // SAH cost of the tree relative to its cost right after the last build, refitting moved primitives makes it grow
+        float GetCostRatio() const;
+
+        // Calls intersectLeaf(firstPrim, primCount) for every leaf whose bounds the ray enters before tmax.
+        // The callback should shrink tmax when it finds a closer hit so far away nodes get culled, setting it
+        // negative ends the traversal which is how any-hit queries stop at the first hit.
+        // Returns the number of nodes visited.
+        template <typename LeafFn>
+        uint32_t Traverse(const glm::vec3& org, const glm::vec3& dir, float& tmax, LeafFn&& intersectLeaf) const;
+
+        const std::vector<BVHNode>& GetNodes() const { return mNodes; }
+        const std::vector<uint32_t>& GetPrimitiveIndices() const { return mPrimIndices; }
+        bool IsEmpty() const { return mNodes.empty(); }
+
+    private:
+        void UpdateNodeBounds(uint32_t nodeIdx, const std::vector<AABB>& primBounds);
+        void Subdivide(uint32_t rootIdx, const std::vector<AABB>& primBounds, const std::vector<glm::vec3>& centroids);
+        void LinkParents();
+        bool RefitNode(uint32_t nodeIdx, const std::vector<AABB>& primBounds);
+        float NodeCost(const BVHNode& node) const;
+
+    private:
+        std::vector<BVHNode> mNodes;
+        std::vector<uint32_t> mPrimIndices;
+        uint32_t mNodesUsed = 0;
+
+        // Only needed for refitting
+        std::vector<uint32_t> mParents;
+        std::vector<uint32_t> mPrimLeaves;
+        double mCost = 0.0;
+        double mBuildCost = 0.0;
+    };
+
+    // Exit distances are scaled up by the worst case rounding error of the slab test (Ize 2013), otherwise a ray
+    // through a triangle's vertex lying on the box boundary can miss the box and slip through a watertight mesh
+    static constexpr float AABBExitScale = 1.0f + 2.0f * 3.0f * (FLT_EPSILON * 0.5f) / (1.0f - 3.0f * (FLT_EPSILON * 0.5f));
+
+    inline float IntersectAABB(const glm::vec3& org, const glm::vec3& invDir, float tmax, const glm::vec3& bmin, const glm::vec3& bmax) {
+        glm::vec3 t0 = (bmin - org) * invDir;
+        glm::vec3 t1 = (bmax - org) * invDir;
+        glm::vec3 tsmall = glm::min(t0, t1);
+        glm::vec3 tbig = glm::max(t0, t1);
+        float tnear = glm::max(glm::max(tsmall.x, tsmall.y), glm::max(tsmall.z, 0.0f));
+        float tfar = glm::min(glm::min(tbig.x, tbig.y) * AABBExitScale, glm::min(tbig.z * AABBExitScale, tmax));
+        return tnear <= tfar ? tnear : FLT_MAX;
+    }
+
+    template <typename LeafFn>
+    uint32_t BVH::Traverse(const glm::vec3& org, const glm::vec3& dir, float& tmax, LeafFn&& intersectLeaf) const {
+        if (mNodes.empty())
+            return 0;
+
+        struct StackEntry {
+            const BVHNode* node;
+            float tNear;
+        };
+
+        const glm::vec3 invDir = 1.0f / dir;
+        StackEntry stack[StackSize];
+        int stackPtr = 0;
+
+        const BVHNode* node = &mNodes[0];
+        if (IntersectAABB(org, invDir, tmax, node->boundsMin, node->boundsMax) == FLT_MAX)
+            return 1;
+
+        uint32_t visited = 1;
+        while (node) {
+            if (node->IsLeaf()) {
+                intersectLeaf(node->leftFirst, node->primCount);
+                node = nullptr;
+            } else {
+                // Visit the nearer child first and push the other one
+                const BVHNode* nearChild = &mNodes[node->leftFirst];
+                const BVHNode* farChild = &mNodes[node->leftFirst + 1];
+                float tNear = IntersectAABB(org, invDir, tmax, nearChild->boundsMin, nearChild->boundsMax);
+                float tFar = IntersectAABB(org, invDir, tmax, farChild->boundsMin, farChild->boundsMax);
+                if (tNear > tFar) {
+                    std::swap(tNear, tFar);
+                    std::swap(nearChild, farChild);
+                }
+
+                node = tNear != FLT_MAX ? nearChild : nullptr;
+                if (tFar != FLT_MAX)
+                    stack[stackPtr++] = { farChild, tFar };
+            }
+
+            // Pop until we find a node that still starts before the closest hit found so far
+            while (!node && stackPtr > 0) {
+                const StackEntry& entry = stack[--stackPtr];
+                if (entry.tNear < tmax)
+                    node = entry.node;
+            }
+            if (node)
+                visited++;
+        }
+        return visited;
+    }
+
+}
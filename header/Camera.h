@@ -3,8 +3,17 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <vector>
+
 namespace Core {
     class Camera {
+    public:
+        // Cached keeps a direction per pixel, Analytic builds each direction from three basis vectors when it's needed
+        enum class RayGeneration {
+            Cached,
+            Analytic
+        };
+
     public:
         Camera();
         Camera(const glm::vec3& position, const glm::vec2& viewport, float fov, float nearClip, float farClip);
@@ -19,9 +28,21 @@ namespace Core {
         void SetPosition(const glm::vec3& position);
         const glm::vec3& GetPosition() const { return mPosition; }
 
+        void SetRayGeneration(RayGeneration mode);
+        RayGeneration GetRayGeneration() const { return mRayGeneration; }
+
+        // Only filled in Cached mode
         const std::vector<glm::vec3>& GetRayDirections() const { return mRayDirections; }
 
+        // World space direction through a point on the image plane in pixels, (0, 0) is the corner of the first pixel.
+        // Works in both modes, fractional positions give sub-pixel rays.
+        glm::vec3 GetRayDirection(float x, float y) const {
+            glm::vec2 ndc = glm::vec2(x / mViewport.x, y / mViewport.y) * 2.0f - 1.0f;
+            return glm::normalize(mForward + ndc.x * mRight + ndc.y * mUp);
+        }
+
     private:
+        void UpdateMatrices();
         void CalculateRayDirections();
 
     private:
@@ -38,7 +59,15 @@ namespace Core {
         glm::mat4 mInverseViewMatrix{1};
         glm::mat4 mInverseProjectionMatrix{1};
 
+        // World space direction to the center of the image plane and the offsets to its right and top edges
+        glm::vec3 mForward{0, 0, -1};
+        glm::vec3 mRight{1, 0, 0};
+        glm::vec3 mUp{0, 1, 0};
+
+        RayGeneration mRayGeneration = RayGeneration::Analytic;
         std::vector<glm::vec3> mRayDirections;
+
+        friend struct CameraBenchmark;
     };
 
 }
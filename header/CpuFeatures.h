@@ -0,0 +1,10 @@
+#pragma once
+
+namespace RT {
+
+    // Whether the CPU and the OS support AVX2, always false on non-x86 builds. SIMD kernels use it to pick their widest variant.
+    bool CpuSupportsAVX2();
+    // Fused multiply-add on 256 bit vectors, which needs the same OS support as AVX2
+    bool CpuSupportsFMA();
+
+}
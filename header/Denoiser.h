@@ -0,0 +1,70 @@
+#pragma once
+
+#include <GBuffer.h>
+#include <ThreadPool.h>
+#include <AlignedAllocator.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+namespace RT {
+
+    // Edge stopping strengths of the denoiser, larger values blur across bigger differences
+    struct DenoiserSettings {
+        int iterations = 5;         // The filter's reach doubles with every one, 5 cover 31 pixels each way
+        float colorSigma = 4.0f;    // In standard deviations of the pixel's noise, halved every iteration
+        float normalSigma = 0.3f;
+        float albedoSigma = 0.1f;
+        float depthSigma = 1.0f;    // In multiples of the depth change the surface's slope predicts for the offset
+    };
+
+    /*
+     *  Edge avoiding a-trous wavelet filter (Dammertz et al. 2010) with noise aware color weights as in SVGF (Schied
+     *  et al. 2017). Every iteration blurs with a 3x3 B-spline whose taps are spread twice as far as in the one
+     *  before, and drops taps whose first hit has a different normal, albedo or depth than the pixel's, or whose
+     *  color differs by more than the noise explains. Color is divided by the first hit's albedo before filtering
+     *  and multiplied back afterwards, so edges between materials stay sharp even where lighting is smooth.
+     *
+     *  Each iteration runs over bands of rows on the thread pool, the AVX2+FMA kernel filters 8 pixels of a row at once.
+    */
+    class Denoiser {
+    public:
+        void Resize(uint32_t width, uint32_t height);
+
+        // Color to filter and the variance of its luminance as a mean of the pixel's samples, negative when the
+        // pixel has too few samples to tell, the noise is then estimated from its neighbours. Albedo is the pixel's
+        // first hit albedo, the one the GBuffer passed to Denoise holds. Color and noise are kept divided by it, the
+        // form the filter works on, so the divisions happen while the caller writes the pixel anyway.
+        void SetPixel(uint32_t pixelIndex, const glm::vec3& color, float variance, const glm::vec3& albedo) {
+            glm::vec3 divisor = glm::max(albedo, glm::vec3(MinAlbedo));
+            mColor[0][pixelIndex] = color.r / divisor.r;
+            mColor[1][pixelIndex] = color.g / divisor.g;
+            mColor[2][pixelIndex] = color.b / divisor.b;
+            float albedoLuminance = std::max(glm::dot(albedo, glm::vec3(0.2126f, 0.7152f, 0.0722f)), MinAlbedo);
+            mDeviation[pixelIndex] = variance >= 0.0f ? std::sqrt(variance) / albedoLuminance : -1.0f;
+        }
+
+        void Denoise(const GBuffer& gbuffer, const DenoiserSettings& settings, ThreadPool& threadPool);
+
+        // Filtered color of the last Denoise call, one plane per channel
+        const float* GetChannel(uint32_t channel) const { return mFiltered[mResult][channel].data(); }
+
+        size_t GetMemoryUsage() const;
+        static const char* GetKernelName();
+
+    public:
+        static constexpr float MinAlbedo = 0.01f;   // Keeps black surfaces from dividing by zero when demodulating
+
+    private:
+        uint32_t mWidth = 0;
+        uint32_t mHeight = 0;
+        Core::AlignedVector<float> mColor[3];       // Demodulated, Denoise leaves it alone so it can be filtered again
+        Core::AlignedVector<float> mDeviation;      // Of the demodulated luminance, negative where the samples can't tell
+        Core::AlignedVector<float> mFiltered[2][3]; // Ping-pong between iterations
+        uint32_t mResult = 0;
+    };
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <AlignedAllocator.h>
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+namespace RT {
+
+    // What a camera ray hit first. Misses keep the defaults: unit albedo so the sky passes the denoiser unchanged,
+    // zero normal and depth so no surface ever looks similar to them.
+    struct FirstHit {
+        glm::vec3 albedo{1.0f};
+        glm::vec3 normal{0.0f};
+        float depth = 0.0f;         // Distance along the camera ray
+    };
+
+    /*
+     *  First hits of every pixel averaged over its samples, kept as running means like the half precision
+     *  accumulation so they can be read without knowing the sample count. One plane per channel, so the denoiser
+     *  can load 8 neighbouring pixels of a channel at once.
+    */
+    struct GBuffer {
+        Core::AlignedVector<float> albedoR, albedoG, albedoB;
+        Core::AlignedVector<float> normalX, normalY, normalZ;
+        Core::AlignedVector<float> depth;
+
+        void Resize(uint32_t pixelCount);
+        void Clear();
+
+        // sampleCount includes the sample being added
+        void AddSample(uint32_t pixelIndex, const FirstHit& hit, uint32_t sampleCount) {
+            float weight = 1.0f / static_cast<float>(sampleCount);
+            albedoR[pixelIndex] += (hit.albedo.r - albedoR[pixelIndex]) * weight;
+            albedoG[pixelIndex] += (hit.albedo.g - albedoG[pixelIndex]) * weight;
+            albedoB[pixelIndex] += (hit.albedo.b - albedoB[pixelIndex]) * weight;
+            normalX[pixelIndex] += (hit.normal.x - normalX[pixelIndex]) * weight;
+            normalY[pixelIndex] += (hit.normal.y - normalY[pixelIndex]) * weight;
+            normalZ[pixelIndex] += (hit.normal.z - normalZ[pixelIndex]) * weight;
+            depth[pixelIndex] += (hit.depth - depth[pixelIndex]) * weight;
+        }
+
+        size_t GetMemoryUsage() const;
+    };
+
+}
@@ -7,6 +7,12 @@
 
 namespace Core {
 
+    // Pixel rectangle inside an image
+    struct ImageRegion {
+        uint32_t x = 0, y = 0;
+        uint32_t width = 0, height = 0;
+    };
+
     struct Image {
         std::vector<uint8_t> pixels = {0};
         const uint32_t width = 0;
@@ -23,6 +29,8 @@ namespace Core {
 
     void DrawPixel(Image* image, int pixelPos, const glm::vec4& color);
     void DrawPixel(Image* image, int pixelPos, const glm::vec3& color);
+    // Both images need the same size and component count
+    void CopyRegion(const Image& source, Image* destination, const ImageRegion& region);
 
 }
 
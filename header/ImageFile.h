@@ -13,7 +13,7 @@ namespace Core {
         ImagePNG(const Image* image);
 
         void Load(const Image* image);
-        void Save(const std::string& fileName);
+        bool Save(const std::string& fileName);     // Appends .png, false if the file couldn't be written
         void FlipVertical(bool enabled);
     private:
         std::unique_ptr<Image> mImage;
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <BVH.h>
+#include <MeshBVH.h>
+#include <Scene.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+namespace RT {
+
+    /*
+     *  Top level of the two level hierarchy: a BVH over the world bounds of every placed mesh whose leaves move the ray
+     *  into the mesh's space and continue in that mesh's MeshBVH. Meshes without instances are placed once as they are.
+     *  Each placement only keeps its inverse transform, mesh and material, so geometry is stored once per mesh no
+     *  matter how often it is instanced.
+    */
+    class InstanceBVH {
+    public:
+        struct Hit {
+            int instance = -1;  // Placement index, see GetMeshIndex and GetMaterialIndex
+            int triangle = -1;  // Triangle index within the mesh
+        };
+
+        // meshBVHs must hold one built tree per scene mesh and outlive this one
+        void Build(const Core::Scene& scene, const std::vector<MeshBVH>& meshBVHs);
+
+        // Closest hit before tmax, tmax shrinks to its distance. Distances are along the world space ray.
+        Hit Intersect(const Core::Scene& scene, const glm::vec3& org, const glm::vec3& dir, float& tmax,
+                      uint64_t& nodeVisits, uint64_t& intersectionTests) const;
+        // Any hit before tmax, stops at the first one found
+        bool Occluded(const Core::Scene& scene, const glm::vec3& org, const glm::vec3& dir, float tmax,
+                      uint64_t& nodeVisits, uint64_t& intersectionTests) const;
+
+        // World space geometric normal of a hit, facing the side the ray came from
+        glm::vec3 GetNormal(const Core::Scene& scene, const Hit& hit, const glm::vec3& dir) const;
+        uint32_t GetMeshIndex(int instance) const { return mPlacements[instance].meshIndex; }
+        int GetMaterialIndex(int instance) const { return mPlacements[instance].materialIndex; }
+
+        uint32_t GetInstanceCount() const { return static_cast<uint32_t>(mPlacements.size()); }
+        size_t GetMemoryUsage() const;
+
+    private:
+        // 3x4 world to object transform, 56 bytes with the rest
+        struct Placement {
+            glm::mat3 linear;
+            glm::vec3 offset;
+            uint32_t meshIndex;
+            int materialIndex;
+        };
+
+    private:
+        BVH mBVH;
+        std::vector<Placement> mPlacements;     // In leaf order
+        const std::vector<MeshBVH>* mMeshBVHs = nullptr;
+    };
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <Scene.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+namespace RT {
+
+    struct LightSample {
+        glm::vec3 direction;    // Unit vector from the shading point towards the light
+        float distance;         // Where a shadow ray has to stop, FLT_MAX for directional lights
+        glm::vec3 radiance;     // Incoming radiance, or irradiance for point and directional lights
+        float pdf;              // Solid angle density times the selection probability, only the latter for delta lights
+        bool isDelta;           // Point and directional lights can't be hit by a ray, so they're never weighted by MIS
+    };
+
+    /*
+     *  Picks one light for next event estimation: emissive spheres, directional and point lights. Half of the samples
+     *  pick lights in proportion to a rough estimate of their power, the other half uniformly, since the estimate
+     *  ignores distance and would starve a dim light next to the shading point. Spheres are sampled uniformly over
+     *  the cone they subtend, which wastes no samples on their hidden side. Build has to run again once lights or
+     *  materials change.
+    */
+    class LightSampler {
+    public:
+        void Build(const Core::Scene& scene);
+        bool IsEmpty() const { return mLights.empty(); }
+
+        // False when the chosen light can't light the point at all, e.g. from inside an emissive sphere
+        bool Sample(const Core::Scene& scene, const glm::vec3& position, float uLight, float u0, float u1, LightSample& sample) const;
+
+        // Density Sample gives the direction towards this sphere from position, 0 for spheres that aren't lights.
+        // Used to weight emission that BSDF sampling found against the light sample taken at the same vertex.
+        float SpherePdf(const Core::Scene& scene, uint32_t sphereIndex, const glm::vec3& position) const;
+
+    private:
+        enum class LightType : uint8_t {
+            Sphere,
+            Directional,
+            Point
+        };
+
+        struct Light {
+            LightType type;
+            uint32_t index;     // Into the scene's spheres or light vectors
+        };
+
+        float SphereWeight(const Core::Scene& scene, const Core::Sphere& sphere) const;
+        float SelectionPdf(float weight) const;
+
+    private:
+        std::vector<Light> mLights;
+        std::vector<float> mCdf;        // Running sum of the weights, the last entry is the total
+        float mTotalWeight = 0.0f;
+    };
+
+}
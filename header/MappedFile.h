@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Core {
+
+    // Read only memory mapping of a whole file, the pages are only read from disk once they are touched
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        MappedFile(const std::string& path);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool Open(const std::string& path);
+        void Close();
+
+        bool IsOpen() const { return mData != nullptr; }
+        const uint8_t* GetData() const { return mData; }
+        size_t GetSize() const { return mSize; }
+
+    private:
+        const uint8_t* mData = nullptr;
+        size_t mSize = 0;
+    #ifdef _WIN32
+        void* mFileHandle = nullptr;
+        void* mMappingHandle = nullptr;
+    #else
+        int mFileDescriptor = -1;
+    #endif
+    };
+
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <BVH.h>
+#include <Scene.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+namespace RT {
+
+    // Per ray constants of the watertight ray/triangle test, computed once and reused for every triangle
+    struct TriangleRay {
+        glm::vec3 org;
+        int kx, ky, kz;     // Axes permuted so the ray direction is largest along kz
+        float sx, sy, sz;   // Shear that maps the ray direction onto the kz axis
+
+        TriangleRay(const glm::vec3& origin, const glm::vec3& dir);
+    };
+
+    /*
+     *  Watertight ray/triangle test (Woop, Benthin and Wald 2013): the triangle is moved into a space where the ray
+     *  runs along +z, so the edge tests share their arithmetic between neighbouring triangles and a ray can't slip
+     *  through the edge between two of them. Returns true for a hit closer than tmax and stores its distance in t.
+    */
+    bool IntersectTriangle(const TriangleRay& ray, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, float tmax, float& t);
+
+    // BVH over the triangles of one mesh. Triangles are stored in leaf order as vertex index triplets, the vertices
+    // themselves stay in the scene's mesh so only 12 bytes per triangle come on top of the tree.
+    class MeshBVH {
+    public:
+        void Build(const Core::Mesh& mesh);
+
+        // Closest triangle hit before tmax, tmax shrinks to its distance. Returns the triangle's index in the mesh or -1.
+        int Intersect(const Core::Mesh& mesh, const glm::vec3& org, const glm::vec3& dir, float& tmax,
+                      uint64_t& nodeVisits, uint64_t& intersectionTests) const;
+        // Any hit before tmax, stops at the first one found
+        bool Occluded(const Core::Mesh& mesh, const glm::vec3& org, const glm::vec3& dir, float tmax,
+                      uint64_t& nodeVisits, uint64_t& intersectionTests) const;
+
+        AABB GetBounds() const;
+        size_t GetMemoryUsage() const;
+
+    private:
+        BVH mBVH;
+        std::vector<uint32_t> mIndices;     // Three vertex indices per triangle, in leaf order
+    };
+
+}
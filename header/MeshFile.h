@@ -0,0 +1,21 @@
+#pragma once
+
+#include <Scene.h>
+
+#include <string>
+
+namespace Core {
+
+    /*
+     *  Triangle mesh loaders. Files are read a chunk at a time, so a model with millions of triangles never has its
+     *  whole text in memory next to the vertex and index arrays it turns into. Polygons are split into triangle fans.
+     *      OBJ: only positions ('v') and faces ('f') are used, every object and group ends up in the same mesh
+     *      PLY: ascii and binary in either byte order, the vertex x/y/z properties and the face vertex_indices list
+    */
+    bool LoadMeshOBJ(const std::string& path, Mesh& mesh);
+    bool LoadMeshPLY(const std::string& path, Mesh& mesh);
+
+    // Picks the loader from the file extension, .obj or .ply
+    bool LoadMesh(const std::string& path, Mesh& mesh);
+
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+namespace RT {
+
+    enum class ToneMapper {
+        Uncharted2,     // Hable's filmic curve
+        ACES,           // Narkowicz's fit of the ACES reference transform
+        Reinhard
+    };
+
+    // Maps linear radiance to display values: exposure and tone mapping, gamma, then 8-bit quantization
+    struct DisplayTransform {
+        bool toneMapping = true;
+        ToneMapper toneMapper = ToneMapper::Uncharted2;
+        float exposure = 1.0f;          // Only applied together with tone mapping
+        bool gammaCorrection = true;
+        float invGamma = 1.0f / 2.2f;
+    };
+
+    // Display transform of a single color, clamped to [0, 1]
+    glm::vec3 ApplyDisplayTransform(const glm::vec3& color, const DisplayTransform& transform);
+
+    // Transforms count pixels given as separate channel arrays and writes them as RGBA8 with full alpha
+    using PostProcessFn = void (*)(const float* r, const float* g, const float* b, uint32_t count,
+                                   const DisplayTransform& transform, uint8_t* rgba);
+
+    // Widest kernel the CPU supports, chosen once through CPUID. The AVX2 kernel does 8 pixels at a time with a
+    // polynomial pow, it can differ from the scalar kernel by one step of the 8-bit output.
+    PostProcessFn GetPostProcessKernel();
+    const char* GetPostProcessKernelName();
+
+    void PostProcessScalar(const float* r, const float* g, const float* b, uint32_t count, const DisplayTransform& transform, uint8_t* rgba);
+
+}
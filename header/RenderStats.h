@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace RT {
+
+    // What a render thread counts while tracing a tile
+    struct RayCounters {
+        uint64_t primaryRays = 0;
+        uint64_t secondaryRays = 0;
+        uint64_t shadowRays = 0;
+        uint64_t intersectionTests = 0;
+        uint64_t bvhNodeVisits = 0;
+        uint64_t samples = 0;
+    };
+
+    // Counters for one call to Renderer::Render
+    struct RenderStats {
+        uint64_t primaryRays = 0;
+        uint64_t secondaryRays = 0;
+        uint64_t shadowRays = 0;           // Light sample visibility tests, they stop at the first hit
+        uint64_t intersectionTests = 0;    // Ray/primitive tests, BVH leaves count every primitive they hold
+        uint64_t bvhNodeVisits = 0;
+        uint64_t samples = 0;              // Path samples accumulated, preview frames don't accumulate any
+        uint32_t samplesPerPixel = 0;
+        uint32_t tilesRendered = 0;
+
+        double frameTimeMs = 0.0;
+        double minTileTimeMs = 0.0;
+        double maxTileTimeMs = 0.0;
+        double avgTileTimeMs = 0.0;
+        double resolveTimeMs = 0.0;        // Part of the frame spent denoising and resolving the whole image after the tiles
+        double reprojectTimeMs = 0.0;      // Part of the frame spent moving the accumulated samples to a new view
+        uint32_t reprojectedPixels = 0;    // Pixels that kept samples through a camera move, 0 when the camera didn't move
+
+        // Indexed by render thread, idle is the part of the frame a thread spent outside of tiles
+        std::vector<double> threadBusyMs;
+        std::vector<double> threadIdleMs;
+
+        uint64_t GetRaysTraced() const { return primaryRays + secondaryRays + shadowRays; }
+        double GetRaysPerSecond() const { return frameTimeMs > 0.0 ? GetRaysTraced() / (frameTimeMs * 0.001) : 0.0; }
+    };
+
+    // A span on the timeline of one thread, times are in microseconds since the capture started
+    struct TraceEvent {
+        const char* name;
+        uint32_t threadIndex;
+        double start;
+        double duration;
+        uint32_t frame;
+        uint32_t tileX;
+        uint32_t tileY;
+    };
+
+    // Writes the events in the Chrome trace event format, open it in chrome://tracing or ui.perfetto.dev
+    bool WriteChromeTrace(const std::string& path, const std::vector<TraceEvent>& events);
+
+}
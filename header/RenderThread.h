@@ -0,0 +1,99 @@
+#pragma once
+
+#include <Renderer.h>
+#include <Scene.h>
+#include <Camera.h>
+#include <Image.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace RT {
+
+    // A finished frame and what the renderer reported about it
+    struct RenderedFrame {
+        std::unique_ptr<Core::Image> image;
+        RenderStats stats;
+        uint32_t frame = 0;             // Frames accumulated into the image
+        float convergence = 0.0f;
+        bool converged = false;
+        bool previewing = false;
+        uint32_t threadCount = 0;
+
+        // Every publish gets a new version, a tile's version is the last one that changed its pixels.
+        // Whoever mirrors the image only has to copy tiles newer than the frame it copied last.
+        uint64_t version = 0;
+        std::vector<Core::ImageRegion> tiles;
+        std::vector<uint64_t> tileVersions;
+    };
+
+    /*
+     *  Runs a Renderer on its own thread so the UI never waits for a frame. The render thread owns its copy of the scene,
+     *  the camera and the renderer, everyone else changes them through commands that run between two frames.
+     *  Finished frames come back through a triple buffer: the render thread always has a buffer to draw into, the UI
+     *  always holds the latest complete frame, and handing one over is a single atomic exchange on either side.
+    */
+    class RenderThread {
+    public:
+        // What a command can touch, always on the render thread
+        struct Context {
+            Core::Scene& scene;
+            Core::Camera& camera;
+            Renderer& renderer;
+            bool& accumulate;
+            bool restart;               // Set when the change invalidates the accumulated image
+        };
+        using Command = std::function<void(Context&)>;
+
+    public:
+        RenderThread(const Core::Scene& scene, const Core::Camera& camera);
+        ~RenderThread();
+
+        RenderThread(const RenderThread&) = delete;
+        RenderThread& operator=(const RenderThread&) = delete;
+
+        // Queues a command for the render thread, it runs before the next frame starts
+        void Submit(Command command);
+        void Resize(uint32_t width, uint32_t height);
+
+        // Returns the newest finished frame, or nullptr if none finished since the last call.
+        // A returned frame stays valid until a later call returns a new one.
+        const RenderedFrame* AcquireFrame();
+
+    private:
+        void Run();
+        void Publish();
+
+    private:
+        static constexpr uint32_t IndexMask = 3;
+        static constexpr uint32_t NewFrameBit = 4;
+
+        Core::Scene mScene;
+        Core::Camera mCamera;
+        Renderer mRenderer;
+        std::unique_ptr<Core::Image> mImage;    // Render target that keeps the pixels of tiles a frame didn't touch
+        uint32_t mFrame = 1;
+        uint32_t mPassTiles = 0;                // Tiles rendered since a command last changed something
+        bool mAccumulate = false;
+        bool mIdle = false;
+        uint64_t mVersion = 0;
+        std::vector<uint64_t> mTileVersions;
+
+        RenderedFrame mFrames[3];
+        uint32_t mBackIndex = 0;                // Only used by the render thread
+        uint32_t mFrontIndex = 1;               // Only used by the UI
+        std::atomic<uint32_t> mMiddle = 2;      // Index of the frame in between, with NewFrameBit set until the UI takes it
+
+        std::mutex mCommandMutex;
+        std::condition_variable mWake;
+        std::vector<Command> mCommands;
+        bool mStopping = false;
+        std::thread mThread;
+    };
+
+}
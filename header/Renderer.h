@@ -1,10 +1,26 @@
 #pragma once
 
 #include <Scene.h>
+#include <BVH.h>
+#include <MeshBVH.h>
+#include <InstanceBVH.h>
+#include <LightSampler.h>
+#include <Sampler.h>
+#include <SphereSoA.h>
+#include <ThreadPool.h>
+#include <RenderStats.h>
+#include <AccumulationBuffer.h>
+#include <PostProcess.h>
+#include <GBuffer.h>
+#include <Denoiser.h>
+#include <Reprojection.h>
 
 #include <Image.h>
 #include <Camera.h>
 #include <memory>
+#include <atomic>
+#include <chrono>
+#include <string>
 
 namespace RT {
 
@@ -14,45 +30,240 @@ namespace RT {
         glm::vec3 dir;
     };
 
+    // Megakernel traces one whole path per pixel, Wavefront traces a tile's paths one bounce at a time
+    enum class Integrator {
+        Megakernel,
+        Wavefront
+    };
+
+    // Everything about a render that can be tweaked between frames, kept together so it can be copied to a render thread in one go
+    struct RenderSettings {
+        Integrator integrator = Integrator::Megakernel;
+        int bounceLimit = 8;
+        // Past russianRouletteDepth bounces paths end at random, the dimmer the more likely, and the survivors get
+        // brighter to make up for it. Keeps the image unbiased while deep bounce limits only cost where light remains.
+        bool russianRoulette = true;
+        int russianRouletteDepth = 3;
+        bool sampleLights = true;   // Next event estimation, a shadow ray towards one light at every diffuse hit
+        bool useBVH = true;
+        float bvhRebuildThreshold = 1.5f; // Rebuild once refitting made the BVH this much more expensive to traverse
+        float gamma = 2.2f;
+        float exposure = 1.0f;
+        bool doGammaCorrection = true;
+        bool doToneMapping = true;
+        ToneMapper toneMapper = ToneMapper::Uncharted2;
+        bool resolveEveryFrame = true;  // Off leaves the image alone during Render, call Resolve once it's needed
+        bool captureTrace = false;
+        bool interactivePreview = true;
+        float targetFrameTimeMs = 0.0f;  // Scales the work per frame to take about this long, 0 renders one sample per pixel
+        bool jitterPrimaryRays = true; // Sub-pixel jitter for anti-aliasing, needs an Analytic camera
+        SamplerType sampler = SamplerType::Sobol; // Takes effect when accumulation restarts
+        AccumulationPrecision accumulation = AccumulationPrecision::Float; // Takes effect when accumulation restarts
+
+        // Adaptive sampling stops sampling a pixel once its relative standard error drops below noiseThreshold
+        bool adaptiveSampling = false;
+        float noiseThreshold = 0.01f;
+        uint32_t minAdaptiveSamples = 16;   // Too few samples give a variance estimate that can't be trusted
+        uint32_t maxSamplesPerFrame = 8;    // Cap on the samples a noisy pixel gets per frame once others converged
+        float convergenceTarget = 0.999f;
+
+        // Filters the accumulated image guided by the first hits before display, for clean previews at a few samples
+        // per pixel. Needs resolveEveryFrame, the whole image is filtered at once after the frame's tiles are done.
+        bool denoise = false;
+        DenoiserSettings denoiser;
+
+        // When only the camera moved since the last frame the accumulated samples are moved to where their surfaces
+        // are in the new view instead of starting over. Pixels that came into view start from scratch, and pixels
+        // whose next sample hits something else than their history drop it.
+        bool temporalReprojection = true;
+        uint32_t reprojectionMaxSamples = 16;       // History weight cap, new samples soon outweigh resampling errors
+        float reprojectionDepthTolerance = 0.05f;   // Relative first hit distance change a pixel keeps its history at
+    };
+
     class Renderer {
     public:
         Renderer(const Core::Scene& scene);
         void Render(const Core::Camera& camera, Core::Image* image, uint32_t frame);
+        // Writes the display transform of the accumulated image, Render does it for the tiles it touched unless settings.resolveEveryFrame is off
+        void Resolve(Core::Image* image);
         void OnResize(uint32_t width, uint32_t height);
+
+        // Rebuilds the BVHs of the spheres, meshes and instances from scratch, use UpdateAccelerationStructure for edits
+        void BuildAccelerationStructure();
+        // Applies the edits recorded in the scene's dirty state, refitting when possible. Doesn't clear the scene's dirty state.
+        void UpdateAccelerationStructure();
+
+        // 0 uses every hardware thread
+        void SetThreadCount(uint32_t threadCount);
+        uint32_t GetThreadCount() const { return mThreadPool.GetThreadCount(); }
+
+        // Call whenever the scene changes, or the camera does with settings.temporalReprojection off. The next Render
+        // calls draw 1/8, 1/4 and 1/2 resolution previews before accumulation restarts at full resolution, so edits
+        // stay responsive on large viewports.
+        void BeginPreview();
+        // True when the last Render call drew one of those previews instead of a sample
+        bool IsPreviewing() const { return mRenderedPreview; }
+
+        // Counters and timings of the last Render call
+        const RenderStats& GetStats() const { return mStats; }
+
+        // Tiles in the order Render works through them, and whether the last Render call wrote a tile's pixels.
+        // A frame with a time budget only covers part of the image, everything else keeps its previous pixels.
+        uint32_t GetTileCount() const { return static_cast<uint32_t>(mTiles.size()); }
+        Core::ImageRegion GetTileRegion(uint32_t tile) const;
+        bool WasTileRendered(uint32_t tile) const;
+
+        // Tile and frame spans recorded while settings.captureTrace is on, exported in the Chrome trace format.
+        // Past MaxTraceEvents the older half of the capture is dropped, so it can stay on indefinitely.
+        void ClearTrace();
+        bool SaveTrace(const std::string& path) const;
+
+        // Every ray cast through the scene, primary and bounces
+        uint64_t GetRaysTraced() const { return mRaysTraced; }
+        void ResetRaysTraced() { mRaysTraced = 0; }
+
+        // Samples accumulated over all pixels since the last reset
+        uint64_t GetSamplesTaken() const;
+        // Fraction of pixels adaptive sampling stopped sampling since the last reset
+        float GetConvergence() const;
+        // True once adaptive sampling is on and at least settings.convergenceTarget of the pixels converged
+        bool IsConverged() const;
     public:
-        int bounceLimit = 8;
-        float gamma = 2.2f;
-        float exposure = 1.0f;
-        bool doGammaCorrection = true;
-        bool doToneMapping = true;
+        static constexpr uint32_t TileSize = 32;
+        static constexpr uint32_t PreviewStartScale = 8;
+        static constexpr uint32_t MaxBudgetSamplesPerPixel = 64;
+        static constexpr uint32_t MinDenoiserVarianceSamples = 4;  // Fewer leave the denoiser to estimate noise from the neighbours
+        static constexpr float MinHistoryCoherence = 0.9f;          // Mean normal length of a history that saw one surface
+        static constexpr size_t MaxTraceEvents = 1 << 18;           // About 12 MB of events over all threads
+
+        RenderSettings settings;
         
     private:
         struct HitInfo {
             glm::vec3 worldPosition;
             glm::vec3 surfaceNormal;
             float hitDistance = -1.0f;
-            int objIdx = -1;
+            int objIdx = -1;        // Sphere index, or triangle index within the mesh for mesh hits
+            int instanceIndex = -1; // Placement in mInstanceBVH for mesh hits
+            int materialIndex = 0;
+        };
+
+        struct Tile {
+            uint32_t x0, y0;
+            uint32_t x1, y1;
+            uint32_t order;
+        };
+
+        // Padded to a cache line so render threads don't share one while flushing their counters
+        struct alignas(64) ThreadStats {
+            RayCounters counters;
+            double busyMs = 0.0;
+            double minTileMs = 1e30;
+            double maxTileMs = 0.0;
+            uint32_t tiles = 0;
+        };
+
+        // Paths of one tile in flight, stored as SoA so each wavefront stage streams through its own arrays
+        struct WavefrontQueue {
+            std::vector<float> orgX, orgY, orgZ;
+            std::vector<float> dirX, dirY, dirZ;
+            std::vector<float> throughputR, throughputG, throughputB;
+            std::vector<uint32_t> pathIndex; // Index into radiance, stays with the path through compaction
+            std::vector<SamplerState> sampler;
+            std::vector<float> bsdfPdf;      // Density the current direction was sampled with, 0 for camera rays and mirrors
+            std::vector<uint32_t> pixel;     // Indexed by pathIndex like radiance
+            std::vector<HitInfo> hits;
+            std::vector<glm::vec3> radiance;
+            std::vector<FirstHit> firstHit;  // Indexed by pathIndex like radiance
+
+            void Resize(uint32_t count);
+            void Move(uint32_t from, uint32_t to);
         };
 
     private:
-        glm::vec3 TraceRay(const Ray& ray);
+        void TraceTile(const Core::Camera& camera, const Tile& tile, uint32_t width, uint32_t samplesPerPixel);
+        void TraceTileWavefront(const Core::Camera& camera, const Tile& tile, uint32_t width, uint32_t samplesPerPixel, WavefrontQueue& queue);
+        glm::vec3 PrimaryRayDirection(const Core::Camera& camera, uint32_t x, uint32_t y, uint32_t width, SamplerState& sampler);
+        void PreviewTile(const Core::Camera& camera, const Tile& tile, Core::Image* image, uint32_t scale, const DisplayTransform& transform);
+        void AddSample(uint32_t pixelIndex, const glm::vec3& color, const FirstHit& firstHit);
+        float RelativeError(uint32_t pixelIndex) const;
+        glm::vec3 TraceRay(const Ray& ray, SamplerState& sampler, FirstHit& firstHit);
+        // Shades a hit and turns the ray into the next bounce, shared by both integrators. bsdfPdf is the density the
+        // ray's direction was sampled with, 0 when no light sample could have produced it, and is updated for the new ray.
+        // Returns false when the path ends there. depth counts the bounces before this hit.
+        bool ScatterRay(const HitInfo& hitInfo, Ray& ray, glm::vec3& contribution, glm::vec3& incomingLight, float& bsdfPdf,
+                        SamplerState& sampler, int depth);
+        // Light emitted towards the ray by whatever it hit, weighted against the light sample the previous vertex took
+        glm::vec3 EmittedLight(const HitInfo& hitInfo, const Ray& ray, float bsdfPdf);
         HitInfo RayIntersectionTest(const Ray& ray);
+        // Any hit before tmax, used by shadow rays
+        bool Occluded(const glm::vec3& org, const glm::vec3& dir, float tmax);
+        void BuildSphereBVH();
+        // Per mesh trees and the instance tree over them
+        void BuildMeshBVHs();
         glm::vec3 RayMiss();
 
-        glm::vec3 ApplyGammaCorrection(const glm::vec3& color);
-        glm::vec3 ApplyToneMapping(const glm::vec3& x);
-
-        uint32_t NextRandom(uint32_t& state);
-        float RandomValue(uint32_t& state);
-        glm::vec3 RandomDirection(uint32_t& state);
-        float RandomValueNormalDistribution(uint32_t& state);
+        // Mean of every pixel in the tile through the display transform into the image
+        void ResolveTile(const Tile& tile, Core::Image* image, const DisplayTransform& transform);
+        // Hands every pixel's mean and noise to the denoiser and filters the whole image
+        void DenoiseImage(uint32_t width, uint32_t height);
+        // Moves the accumulated samples from the view of the last frame into the camera's
+        void Reproject(const Core::Camera& camera, uint32_t width, uint32_t height);
+        // Keeps a reprojected pixel's history if its first new sample hit the same surface, drops it otherwise
+        void VerifyHistory(uint32_t pixelIndex, const FirstHit& firstHit);
+        DisplayTransform GetDisplayTransform() const;
+        // Drops the events before the middle of the capture once it holds MaxTraceEvents
+        void TrimTrace();
 
     private:
         const Core::Scene& mScene;
-        glm::vec3* mAccumulatedData = nullptr;
-        std::vector<uint32_t> mVerticalIter;
-        std::vector<uint32_t> mHorizontalIter;
-        inline static thread_local uint32_t mRNG = 1;
+        BVH mBVH;
+        std::vector<AABB> mSphereBounds;
+        SphereSoA mSpheres;
+        std::vector<MeshBVH> mMeshBVHs;     // One per scene mesh
+        InstanceBVH mInstanceBVH;
+        LightSampler mLightSampler;
+        Sampler mSampler;
+        size_t mBuiltInstanceCount = 0;
+        SphereIntersectFn mIntersectSpheres = nullptr;
+        PostProcessFn mPostProcess = nullptr;
+        AccumulationBuffer mAccumulation;
+        std::vector<float> mLuminanceSquares;   // Running sum of squared sample luminance per pixel
+        std::vector<uint32_t> mSampleCounts;
+        std::vector<uint8_t> mPixelConverged;
+        GBuffer mGBuffer;
+        Denoiser mDenoiser;
+        bool mDenoised = false;         // Whether the last resolve read the denoiser's output
+        Reprojection mReprojection;
+        std::vector<glm::vec3> mHistoryMeans;   // The previous view's pixels while they're reprojected
+        std::vector<uint32_t> mHistorySampleCounts;
+        std::vector<float> mHistoryLuminanceSquares;
+        GBuffer mHistoryGBuffer;
+        std::vector<uint8_t> mHistoryUnverified;    // Reprojected pixels that didn't get a sample since
+        glm::mat4 mHistoryView{1};      // Camera the accumulated samples were taken with
+        glm::mat4 mHistoryProjection{1};
+        bool mHasHistory = false;
+        uint32_t mReprojectedPixels = 0;
+        std::atomic<uint32_t> mConvergedPixels = 0;
+        double mSamplesPerMs = 0.0;     // Measured throughput the frame time target is based on
+        uint32_t mNextTile = 0;
+        uint32_t mRenderedFirstTile = 0;
+        uint32_t mRenderedTileCount = 0;
+        bool mRenderedPreview = false;
+        uint32_t mPreviewScale = 1;
+        bool mPreviewResetPending = false;
+        std::vector<Tile> mTiles; // Sorted in Morton order
+        ThreadPool mThreadPool;
+        std::vector<WavefrontQueue> mWavefrontQueues; // One per render thread
+        std::atomic<uint64_t> mRaysTraced = 0;
+        std::vector<ThreadStats> mThreadStats;
+        RenderStats mStats;
+        std::vector<std::vector<TraceEvent>> mTraceEvents; // One list per render thread
+        std::chrono::steady_clock::time_point mTraceStart;
+        bool mTraceStarted = false;
+        inline static thread_local RayCounters mCounters; // Flushed into mThreadStats once per tile
+
+        friend struct RendererBenchmark;
     };
 
 }
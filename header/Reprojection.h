@@ -0,0 +1,44 @@
+#pragma once
+
+#include <GBuffer.h>
+#include <ThreadPool.h>
+#include <Camera.h>
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace RT {
+
+    /*
+     *  Maps the pixels of a new view to the pixels of the previous one that saw the same surface. Every first hit of
+     *  the previous view is moved to world space along its camera ray, projected into the new view and written to the
+     *  pixel it lands on, the nearest one wins where several land together. Pixels nothing lands on were hidden or off
+     *  screen before and have no history. One pixel wide cracks, which a camera moving closer opens between surfaces
+     *  that are still continuous, are closed from their neighbours.
+     *
+     *  Only the position of the first hit is checked here, a surface that moved in front of the history since is only
+     *  noticed once the pixel's next sample finds something else, see Renderer::AddSample.
+    */
+    class Reprojection {
+    public:
+        static constexpr int32_t NoSource = -1;
+
+        // The previous view's matrices as the camera reported them, gbuffer and sampleCounts still of the previous view
+        void Build(const glm::mat4& previousView, const glm::mat4& previousProjection, const Core::Camera& camera,
+                   const GBuffer& gbuffer, const std::vector<uint32_t>& sampleCounts, uint32_t width, uint32_t height,
+                   ThreadPool& threadPool);
+
+        // Pixel of the previous view, or NoSource
+        int32_t GetSource(uint32_t pixelIndex) const { return mSources[pixelIndex]; }
+        // Distance of the source's first hit from the new camera, 0 for misses like FirstHit::depth
+        float GetDepth(uint32_t pixelIndex) const { return mDepths[pixelIndex]; }
+
+    private:
+        std::vector<uint64_t> mTargets;     // Distance bits above the source pixel, so the smallest value is the nearest hit
+        std::vector<int32_t> mSources;
+        std::vector<float> mDepths;
+    };
+
+}
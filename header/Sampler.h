@@ -0,0 +1,61 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+namespace RT {
+
+    enum class SamplerType {
+        Sobol,          // Owen scrambled Sobol points, padded pair by pair with a shuffled index (Burley 2020)
+        BlueNoise,      // R2 sequence offset per pixel by a blue noise mask, the error looks like fine grain
+        PCG             // Independent white noise from a PCG hash, for reference
+    };
+
+    // Where a path is in its pixel sample. Small enough to travel with every path of the wavefront queue.
+    struct SamplerState {
+        uint32_t x, y;
+        uint32_t index;         // Sample of the pixel
+        uint32_t dimension;     // First dimension of the current bounce
+        uint32_t seed;          // Scrambling seed of the pixel, or the running PCG state
+    };
+
+    // Dimensions of a path sample. Each use gets its own dimensions so e.g. the pixel jitter and the first
+    // bounce's direction never come from the same numbers. 2D samples start at even dimensions, which is where the
+    // Sobol pairs start.
+    namespace SampleDimension {
+        constexpr uint32_t Pixel = 0;           // 2D jitter inside the pixel
+        constexpr uint32_t Lens = 2;            // 2D, kept for a camera with an aperture
+        constexpr uint32_t FirstBounce = 4;
+
+        // Offsets from the first dimension of a bounce
+        constexpr uint32_t Light = 0;           // 2D position on the light
+        constexpr uint32_t BSDF = 2;            // 2D direction within the lobe
+        constexpr uint32_t LightSelection = 4;  // Paired with Lobe, both are drawn with one 2D sample
+        constexpr uint32_t Lobe = 5;
+        constexpr uint32_t Termination = 6;     // Russian roulette, the other half of its pair is unused
+        constexpr uint32_t PerBounce = 8;
+    }
+
+    /*
+     *  Random numbers of the path samples. A pixel's sample with the same index always gets the same numbers, no
+     *  matter which frame, thread or integrator takes it. Sobol and blue noise stratify the samples of a pixel
+     *  against each other so images converge faster than with white noise, and are decorrelated between pixels
+     *  and dimensions by hashing both into the scrambling. PCG draws one number after the other and ignores the
+     *  dimension.
+    */
+    class Sampler {
+    public:
+        void SetType(SamplerType type);
+        SamplerType GetType() const { return mType; }
+
+        SamplerState Start(uint32_t x, uint32_t y, uint32_t width, uint32_t sampleIndex) const;
+        float Get1D(SamplerState& state, uint32_t dimension) const;
+        glm::vec2 Get2D(SamplerState& state, uint32_t dimension) const;
+
+    private:
+        SamplerType mType = SamplerType::Sobol;
+        const uint32_t* mBlueNoise = nullptr;   // Ranks of the mask as 32-bit fixed point values
+    };
+
+}
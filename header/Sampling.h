@@ -0,0 +1,43 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+namespace RT {
+
+    // Tangent and bitangent completing a unit normal to an orthonormal basis, without a branch on the axis (Duff et al. 2017)
+    inline void OrthonormalBasis(const glm::vec3& n, glm::vec3& tangent, glm::vec3& bitangent) {
+        float sign = std::copysign(1.0f, n.z);
+        float a = -1.0f / (sign + n.z);
+        float b = n.x * n.y * a;
+        tangent = glm::vec3(1.0f + sign * n.x * n.x * a, sign * b, -sign * n.x);
+        bitangent = glm::vec3(b, sign + n.y * n.y * a, -n.y);
+    }
+
+    // Point on the unit disk, the square is mapped ring by ring (Shirley and Chiu 1997) so stratified inputs stay stratified
+    inline glm::vec2 SampleConcentricDisk(float u0, float u1) {
+        float a = 2.0f * u0 - 1.0f;
+        float b = 2.0f * u1 - 1.0f;
+        if (a == 0.0f && b == 0.0f)
+            return glm::vec2(0.0f);
+        float r, phi;
+        if (std::abs(a) > std::abs(b)) {
+            r = a;
+            phi = glm::quarter_pi<float>() * (b / a);
+        } else {
+            r = b;
+            phi = glm::half_pi<float>() - glm::quarter_pi<float>() * (a / b);
+        }
+        return r * glm::vec2(std::cos(phi), std::sin(phi));
+    }
+
+    // Cosine distributed direction around +z, its density is z / pi
+    inline glm::vec3 SampleCosineHemisphere(float u0, float u1) {
+        glm::vec2 d = SampleConcentricDisk(u0, u1);
+        return glm::vec3(d.x, d.y, std::sqrt(std::max(0.0f, 1.0f - d.x * d.x - d.y * d.y)));
+    }
+
+}
@@ -2,6 +2,8 @@
 
 #include <glm/glm.hpp>
 #include <vector>
+#include <string>
+#include <cstdint>
 
 namespace Core {
 
@@ -33,6 +35,34 @@ namespace Core {
         int materialIndex = 0;
     };
 
+    // Indexed triangle mesh. Positions are kept as one array per axis so loaders append them without padding and
+    // the renderer can read them with wide loads, indices hold three vertices per triangle.
+    struct Mesh {
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<float> z;
+        std::vector<uint32_t> indices;
+        int materialIndex = 0;
+        std::string source;     // File the mesh was loaded from, text scenes reference it by this path
+
+        uint32_t GetVertexCount() const { return static_cast<uint32_t>(x.size()); }
+        uint32_t GetTriangleCount() const { return static_cast<uint32_t>(indices.size() / 3); }
+        glm::vec3 GetVertex(uint32_t index) const { return glm::vec3(x[index], y[index], z[index]); }
+        void AddVertex(const glm::vec3& position) {
+            x.push_back(position.x);
+            y.push_back(position.y);
+            z.push_back(position.z);
+        }
+    };
+
+    // A mesh placed with its own transform. Any number of instances share the mesh's geometry and acceleration
+    // structure, a mesh referenced by at least one instance is only drawn through its instances.
+    struct Instance {
+        glm::mat4 transform{1.0f};  // Object to world, affine
+        uint32_t meshIndex = 0;
+        int materialIndex = -1;     // Replaces the mesh's material unless negative
+    };
+
     struct SkyLight {
         glm::vec3 color = glm::vec3(0.6f, 0.7f, 0.9);
         float strength = 1.0f;
@@ -45,7 +75,25 @@ namespace Core {
         std::vector<PointLight> pointLights;
         std::vector<Material> materials;    // First material is always pink so that any object that doesn't have a material has a default value
         std::vector<Sphere> spheres;
+        std::vector<Mesh> meshes;           // Static, the renderer builds their acceleration structures once
+        std::vector<Instance> instances;    // Static like the meshes
+
+        // Edit tracking so the renderer can refit its acceleration structure instead of rebuilding it every change.
+        // Whoever consumes the changes is responsible for calling ClearDirty afterwards.
+        std::vector<uint32_t> dirtySpheres;
+        bool spheresAddedOrRemoved = false;
+
+        void MarkSphereDirty(uint32_t index) { dirtySpheres.push_back(index); }
+        void MarkSpheresAddedOrRemoved() { spheresAddedOrRemoved = true; }
+        bool HasDirtySpheres() const { return spheresAddedOrRemoved || !dirtySpheres.empty(); }
+        void ClearDirty() {
+            dirtySpheres.clear();
+            spheresAddedOrRemoved = false;
+        }
     };
 
+    // The scene the viewer opens with
+    Scene CreateDefaultScene();
+
 }
 
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Scene.h>
+
+#include <glm/glm.hpp>
+#include <string>
+
+namespace Core {
+
+    // Matches the Camera constructor arguments
+    struct CameraSettings {
+        glm::vec3 position{0, 0, 3};
+        float fov = 45.0f;
+        float nearClip = 0.1f;
+        float farClip = 1000.0f;
+    };
+
+    /*
+     *  Text scenes (.rtscene) have one entry per line, '#' starts a comment:
+     *      sky        r g b strength
+     *      material   albedoR albedoG albedoB emissionR emissionG emissionB emissionStrength shininess
+     *      sphere     x y z radius materialIndex
+     *      dirlight   dirX dirY dirZ r g b intensity
+     *      pointlight x y z r g b intensity
+     *      camera     x y z fov nearClip farClip
+     *      mesh       materialIndex path           (.obj or .ply, relative to the scene file)
+     *      instance   meshIndex materialIndex m00 m01 m02 m03 m10 m11 m12 m13 m20 m21 m22 m23
+     *                 (object to world matrix by rows, translation in the last column, materialIndex -1 keeps the mesh's)
+     *
+     *  Binary scenes (.rtsb) are a header followed by the raw arrays, loading one memory maps the file
+     *  and copies each array into the scene in one go without any parsing. Meshes are stored in the file itself.
+    */
+    bool LoadSceneText(const std::string& path, Scene& scene, CameraSettings& camera);
+    bool SaveSceneText(const std::string& path, const Scene& scene, const CameraSettings& camera);
+    bool LoadSceneBinary(const std::string& path, Scene& scene, CameraSettings& camera);
+    bool SaveSceneBinary(const std::string& path, const Scene& scene, const CameraSettings& camera);
+
+    // Pick the format from the file extension, anything other than .rtsb is treated as text
+    bool LoadScene(const std::string& path, Scene& scene, CameraSettings& camera);
+    bool SaveScene(const std::string& path, const Scene& scene, const CameraSettings& camera);
+
+}
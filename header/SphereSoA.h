@@ -0,0 +1,44 @@
+#pragma once
+
+#include <Scene.h>
+#include <AlignedAllocator.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+namespace RT {
+
+    // Packed copy of Scene::spheres for the SIMD intersection kernels. Spheres are stored in the order the BVH
+    // references them so every leaf is a contiguous range of slots.
+    struct SphereSoA {
+        static constexpr uint32_t LaneCount = 8;
+
+        Core::AlignedVector<float> x;
+        Core::AlignedVector<float> y;
+        Core::AlignedVector<float> z;
+        Core::AlignedVector<float> radius;
+        Core::AlignedVector<int> materialIndex;
+
+        std::vector<uint32_t> sceneIndex; // slot -> index in Scene::spheres
+        std::vector<uint32_t> slot;       // index in Scene::spheres -> slot
+        uint32_t count = 0;
+
+        // order[i] is the scene index of the sphere stored in slot i
+        void Build(const std::vector<Core::Sphere>& spheres, const std::vector<uint32_t>& order);
+        void Update(uint32_t sceneIdx, const Core::Sphere& sphere);
+    };
+
+    // Tests the spheres in slots [first, first + count) and returns the slot of the closest hit in front of the ray
+    // that is nearer than tmin, or -1. tmin is updated to the hit distance.
+    using SphereIntersectFn = int (*)(const SphereSoA& spheres, uint32_t first, uint32_t count,
+                                      const glm::vec3& org, const glm::vec3& dir, float& tmin);
+
+    // Widest kernel the CPU supports, chosen once through CPUID
+    SphereIntersectFn GetSphereIntersectKernel();
+    const char* GetSphereIntersectKernelName();
+
+    int IntersectSpheresScalar(const SphereSoA& spheres, uint32_t first, uint32_t count, const glm::vec3& org, const glm::vec3& dir, float& tmin);
+
+}
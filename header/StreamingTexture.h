@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <Image.h>
+
+namespace RT {
+
+    /*
+     *  Texture for an RGBA8 image that changes every frame. The storage is immutable and only reallocated when the size
+     *  changes, pixels go through a ring of pixel buffers so the copy to the GPU runs asynchronously. With GL 4.4 the
+     *  buffers stay persistently mapped and a fence per buffer tells when the GPU is done reading one, older contexts
+     *  (e.g. Mesa's llvmpipe in a compatibility profile) map and unmap the buffer on every upload instead.
+    */
+    class StreamingTexture {
+    public:
+        StreamingTexture() = default;
+        ~StreamingTexture();
+
+        StreamingTexture(const StreamingTexture&) = delete;
+        StreamingTexture& operator=(const StreamingTexture&) = delete;
+
+        // Uploads the regions of the image that changed, or all of it when the size differs from the last upload
+        void Upload(const Core::Image& image, const std::vector<Core::ImageRegion>& regions);
+
+        uint32_t GetID() const { return mRendererID; }
+        uint32_t GetWidth() const { return mWidth; }
+        uint32_t GetHeight() const { return mHeight; }
+        bool IsPersistentlyMapped() const { return mPersistent; }
+
+        // Frees the GL objects, call it while the context is still current
+        void Release();
+
+    private:
+        void Allocate(uint32_t width, uint32_t height);
+
+    private:
+        static constexpr uint32_t RingSize = 3;
+
+        uint32_t mRendererID = 0;
+        uint32_t mWidth = 0;
+        uint32_t mHeight = 0;
+        bool mPersistent = false;
+
+        uint32_t mBuffers[RingSize] = {};
+        uint8_t* mMapped[RingSize] = {};
+        void* mFences[RingSize] = {};       // GLsync of the last upload that read the buffer
+        uint32_t mRingIndex = 0;
+    };
+
+}
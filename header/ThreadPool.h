@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace RT {
+
+    // Fixed set of worker threads, each with its own task deque. Workers pop from the front of their own deque
+    // and steal from the back of the others once they run dry, so neighbouring tasks stay on the same thread.
+    class ThreadPool {
+    public:
+        // 0 uses every hardware thread
+        explicit ThreadPool(uint32_t threadCount = 0);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        void SetThreadCount(uint32_t threadCount);
+        uint32_t GetThreadCount() const { return static_cast<uint32_t>(mWorkers.size()); }
+
+        // Calls task(taskIndex, threadIndex) for every index in [0, taskCount) and returns once all of them finished.
+        // The calling thread works as thread 0. Tasks are dealt out in contiguous runs so their order should reflect locality.
+        void ParallelFor(uint32_t taskCount, const std::function<void(uint32_t, uint32_t)>& task);
+
+    private:
+        struct Worker {
+            std::deque<uint32_t> tasks;
+            std::mutex mutex;
+        };
+
+        void WorkerLoop(uint32_t threadIndex);
+        void RunTasks(uint32_t threadIndex);
+        bool PopTask(uint32_t threadIndex, uint32_t& task);
+        bool StealTask(uint32_t threadIndex, uint32_t& task);
+        void StopWorkers();
+
+    private:
+        std::vector<std::unique_ptr<Worker>> mWorkers;
+        std::vector<std::thread> mThreads;
+
+        const std::function<void(uint32_t, uint32_t)>* mJob = nullptr;
+        std::atomic<uint32_t> mPending = 0;
+
+        std::mutex mJobMutex;
+        std::condition_variable mWakeCondition;
+        std::condition_variable mDoneCondition;
+        uint64_t mGeneration = 0;
+        bool mStop = false;
+    };
+
+}
@@ -0,0 +1,36 @@
+#include <AccumulationBuffer.h>
+
+namespace RT {
+
+    void AccumulationBuffer::Resize(uint32_t pixelCount) {
+        mPixelCount = pixelCount;
+        Clear();
+    }
+
+    void AccumulationBuffer::SetPrecision(AccumulationPrecision precision) {
+        mPrecision = precision;
+        Clear();
+    }
+
+    // Only the storage of the current precision is kept, switching frees the others
+    void AccumulationBuffer::Clear() {
+        size_t halfCount = mPrecision == AccumulationPrecision::Half ? static_cast<size_t>(mPixelCount) * 4 : 0;
+        size_t floatCount = mPrecision == AccumulationPrecision::Float ? mPixelCount : 0;
+        size_t doubleCount = mPrecision == AccumulationPrecision::Double ? static_cast<size_t>(mPixelCount) * 4 : 0;
+
+        mHalf.assign(halfCount, 0);
+        mFloat.assign(floatCount, glm::vec4(0.0f));
+        mDouble.assign(doubleCount, 0.0);
+        if (halfCount == 0)
+            Core::AlignedVector<uint16_t>().swap(mHalf);
+        if (floatCount == 0)
+            Core::AlignedVector<glm::vec4>().swap(mFloat);
+        if (doubleCount == 0)
+            Core::AlignedVector<double>().swap(mDouble);
+    }
+
+    size_t AccumulationBuffer::GetMemoryUsage() const {
+        return mHalf.capacity() * sizeof(uint16_t) + mFloat.capacity() * sizeof(glm::vec4) + mDouble.capacity() * sizeof(double);
+    }
+
+}
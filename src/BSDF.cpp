@@ -0,0 +1,125 @@
+#include <BSDF.h>
+#include <Sampling.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/gtc/constants.hpp>
+
+namespace RT {
+
+    // Below this roughness the GGX lobe is narrower than float precision can sample, it's treated as a mirror
+    static constexpr float MirrorAlpha = 1e-3f;
+
+    // Smith's shadowing term for GGX, the masking function is 1 / (1 + Lambda)
+    static float GGXLambda(const glm::vec3& w, float alphaSquared) {
+        float cosSquared = w.z * w.z;
+        float tanSquared = std::max(0.0f, 1.0f - cosSquared) / cosSquared;
+        return 0.5f * (std::sqrt(1.0f + alphaSquared * tanSquared) - 1.0f);
+    }
+
+    static float GGXDistribution(float cosThetaM, float alphaSquared) {
+        float denominator = cosThetaM * cosThetaM * (alphaSquared - 1.0f) + 1.0f;
+        return alphaSquared / (glm::pi<float>() * denominator * denominator);
+    }
+
+    // Microfacet normal from the distribution of normals visible from wo (Heitz 2018), so no samples are wasted on
+    // facets facing away and the weight stays close to 1
+    static glm::vec3 SampleGGXVisibleNormal(const glm::vec3& wo, float alpha, float u0, float u1) {
+        glm::vec3 stretched = glm::normalize(glm::vec3(alpha * wo.x, alpha * wo.y, wo.z));
+        float lengthSquared = stretched.x * stretched.x + stretched.y * stretched.y;
+        glm::vec3 t1 = lengthSquared > 0.0f ? glm::vec3(-stretched.y, stretched.x, 0.0f) / std::sqrt(lengthSquared) : glm::vec3(1.0f, 0.0f, 0.0f);
+        glm::vec3 t2 = glm::cross(stretched, t1);
+
+        float r = std::sqrt(u0);
+        float phi = 2.0f * glm::pi<float>() * u1;
+        float p1 = r * std::cos(phi);
+        float p2 = r * std::sin(phi);
+        float s = 0.5f * (1.0f + stretched.z);
+        p2 = (1.0f - s) * std::sqrt(std::max(0.0f, 1.0f - p1 * p1)) + s * p2;
+
+        glm::vec3 normal = p1 * t1 + p2 * t2 + std::sqrt(std::max(0.0f, 1.0f - p1 * p1 - p2 * p2)) * stretched;
+        return glm::normalize(glm::vec3(alpha * normal.x, alpha * normal.y, std::max(0.0f, normal.z)));
+    }
+
+    BSDF::BSDF(const Core::Material& material, const glm::vec3& normal)
+        : mNormal(normal), mAlbedo(material.albedo) {
+        OrthonormalBasis(mNormal, mTangent, mBitangent);
+        mSpecularWeight = std::clamp(material.shininess, 0.0f, 1.0f);
+        mDiffuseWeight = 1.0f - mSpecularWeight;
+        float roughness = 1.0f - mSpecularWeight;
+        mAlpha = roughness * roughness;
+        mMirror = mAlpha < MirrorAlpha;
+    }
+
+    glm::vec3 BSDF::ToLocal(const glm::vec3& v) const {
+        return glm::vec3(glm::dot(v, mTangent), glm::dot(v, mBitangent), glm::dot(v, mNormal));
+    }
+
+    glm::vec3 BSDF::ToWorld(const glm::vec3& v) const {
+        return mTangent * v.x + mBitangent * v.y + mNormal * v.z;
+    }
+
+    // Views from grazing angles or slightly below the surface, as interpolated normals produce them, are lifted just
+    // above it so both lobes stay defined
+    static glm::vec3 LiftAboveSurface(glm::vec3 wo) {
+        wo.z = std::max(wo.z, 1e-4f);
+        return glm::normalize(wo);
+    }
+
+    void BSDF::EvaluateLocal(const glm::vec3& wo, const glm::vec3& wi, glm::vec3& value, float& pdf) const {
+        value = glm::vec3(0.0f);
+        pdf = 0.0f;
+        if (wi.z <= 0.0f)
+            return;
+
+        if (mDiffuseWeight > 0.0f) {
+            float diffusePdf = mDiffuseWeight * wi.z / glm::pi<float>();
+            value += mAlbedo * diffusePdf;
+            pdf += diffusePdf;
+        }
+        if (mSpecularWeight > 0.0f && !mMirror) {
+            float alphaSquared = mAlpha * mAlpha;
+            glm::vec3 halfVector = glm::normalize(wo + wi);
+            float distribution = GGXDistribution(halfVector.z, alphaSquared);
+            float lambdaO = GGXLambda(wo, alphaSquared);
+            float lambdaI = GGXLambda(wi, alphaSquared);
+            // D G2 / (4 cos_o cos_i) times cos_i, and the visible normal density D G1(wo) / (4 cos_o)
+            value += mAlbedo * (mSpecularWeight * distribution / ((1.0f + lambdaO + lambdaI) * 4.0f * wo.z));
+            pdf += mSpecularWeight * distribution / ((1.0f + lambdaO) * 4.0f * wo.z);
+        }
+    }
+
+    bool BSDF::Sample(const glm::vec3& wo, float uLobe, float u0, float u1, BSDFSample& sample) const {
+        glm::vec3 localWo = LiftAboveSurface(ToLocal(wo));
+        glm::vec3 localWi;
+        if (uLobe < mSpecularWeight) {
+            if (mMirror) {
+                // Lobe probability and weight cancel, only the albedo is left
+                sample.direction = ToWorld(glm::vec3(-localWo.x, -localWo.y, localWo.z));
+                sample.weight = mAlbedo;
+                sample.pdf = 0.0f;
+                return true;
+            }
+            glm::vec3 microNormal = SampleGGXVisibleNormal(localWo, mAlpha, u0, u1);
+            localWi = 2.0f * glm::dot(localWo, microNormal) * microNormal - localWo;
+        } else {
+            localWi = SampleCosineHemisphere(u0, u1);
+        }
+
+        glm::vec3 value;
+        EvaluateLocal(localWo, localWi, value, sample.pdf);
+        if (sample.pdf <= 0.0f)
+            return false;
+        sample.direction = ToWorld(localWi);
+        sample.weight = value / sample.pdf;
+        return true;
+    }
+
+    glm::vec3 BSDF::Evaluate(const glm::vec3& wo, const glm::vec3& wi, float& pdf) const {
+        glm::vec3 value;
+        EvaluateLocal(LiftAboveSurface(ToLocal(wo)), ToLocal(wi), value, pdf);
+        return value;
+    }
+
+}
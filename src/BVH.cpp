@@ -0,0 +1,255 @@
+#include <BVH.h>
+
+#include <algorithm>
+
+namespace RT {
+
+    static constexpr int BinCount = 12;
+    static constexpr uint32_t MaxLeafSize = 4;
+    // Past this depth nodes are split at the median so the tree can never outgrow the traversal stack
+    static constexpr uint32_t MedianSplitDepth = 40;
+
+    // Relative costs used by the surface area heuristic
+    static constexpr float TraversalCost = 1.0f;
+    static constexpr float IntersectionCost = 1.0f;
+
+    void BVH::Build(const std::vector<AABB>& primBounds) {
+        Clear();
+        if (primBounds.empty())
+            return;
+
+        uint32_t primCount = static_cast<uint32_t>(primBounds.size());
+        mPrimIndices.resize(primCount);
+        for (uint32_t i = 0; i < primCount; i++)
+            mPrimIndices[i] = i;
+
+        std::vector<glm::vec3> centroids(primCount);
+        for (uint32_t i = 0; i < primCount; i++)
+            centroids[i] = primBounds[i].Center();
+
+        // A binary tree with N leaves has at most 2N - 1 nodes
+        mNodes.resize(2 * primCount - 1);
+        BVHNode& root = mNodes[0];
+        root.leftFirst = 0;
+        root.primCount = primCount;
+        mNodesUsed = 1;
+        UpdateNodeBounds(0, primBounds);
+        Subdivide(0, primBounds, centroids);
+        mNodes.resize(mNodesUsed);
+        LinkParents();
+
+        mCost = 0.0;
+        for (const BVHNode& node : mNodes)
+            mCost += NodeCost(node);
+        float rootArea = AABB{mNodes[0].boundsMin, mNodes[0].boundsMax}.SurfaceArea();
+        mBuildCost = rootArea > 0.0f ? mCost / rootArea : 0.0;
+    }
+
+    void BVH::Clear() {
+        mNodes.clear();
+        mPrimIndices.clear();
+        mParents.clear();
+        mPrimLeaves.clear();
+        mNodesUsed = 0;
+        mCost = 0.0;
+        mBuildCost = 0.0;
+    }
+
+    void BVH::Refit(const std::vector<uint32_t>& dirtyPrims, const std::vector<AABB>& primBounds) {
+        if (mNodes.empty() || dirtyPrims.empty())
+            return;
+
+        // Walking up from every leaf costs O(dirty * depth), once a good part of the scene moved a single
+        // bottom up pass is cheaper. Children are always allocated after their parent so reverse order visits them first.
+        if (dirtyPrims.size() * 8 > mPrimIndices.size()) {
+            for (uint32_t i = static_cast<uint32_t>(mNodes.size()); i-- > 0;)
+                RefitNode(i, primBounds);
+            return;
+        }
+
+        for (uint32_t prim : dirtyPrims) {
+            uint32_t nodeIdx = mPrimLeaves[prim];
+            // Stop as soon as a node's bounds didn't change since nothing above it will either
+            while (RefitNode(nodeIdx, primBounds) && nodeIdx != 0)
+                nodeIdx = mParents[nodeIdx];
+        }
+    }
+
+    float BVH::GetCostRatio() const {
+        if (mNodes.empty() || mBuildCost <= 0.0)
+            return 1.0f;
+        double rootArea = AABB{mNodes[0].boundsMin, mNodes[0].boundsMax}.SurfaceArea();
+        if (rootArea <= 0.0)
+            return 1.0f;
+        return static_cast<float>((mCost / rootArea) / mBuildCost);
+    }
+
+    void BVH::LinkParents() {
+        mParents.assign(mNodes.size(), 0);
+        mPrimLeaves.assign(mPrimIndices.size(), 0);
+        for (uint32_t i = 0; i < mNodes.size(); i++) {
+            const BVHNode& node = mNodes[i];
+            if (node.IsLeaf()) {
+                for (uint32_t j = 0; j < node.primCount; j++)
+                    mPrimLeaves[mPrimIndices[node.leftFirst + j]] = i;
+            } else {
+                mParents[node.leftFirst] = i;
+                mParents[node.leftFirst + 1] = i;
+            }
+        }
+    }
+
+    bool BVH::RefitNode(uint32_t nodeIdx, const std::vector<AABB>& primBounds) {
+        BVHNode& node = mNodes[nodeIdx];
+        AABB bounds;
+        if (node.IsLeaf()) {
+            for (uint32_t i = 0; i < node.primCount; i++)
+                bounds.Grow(primBounds[mPrimIndices[node.leftFirst + i]]);
+        } else {
+            const BVHNode& left = mNodes[node.leftFirst];
+            const BVHNode& right = mNodes[node.leftFirst + 1];
+            bounds = AABB{glm::min(left.boundsMin, right.boundsMin), glm::max(left.boundsMax, right.boundsMax)};
+        }
+
+        if (bounds.min == node.boundsMin && bounds.max == node.boundsMax)
+            return false;
+
+        mCost -= NodeCost(node);
+        node.boundsMin = bounds.min;
+        node.boundsMax = bounds.max;
+        mCost += NodeCost(node);
+        return true;
+    }
+
+    float BVH::NodeCost(const BVHNode& node) const {
+        float area = AABB{node.boundsMin, node.boundsMax}.SurfaceArea();
+        return node.IsLeaf() ? IntersectionCost * node.primCount * area : TraversalCost * area;
+    }
+
+    void BVH::UpdateNodeBounds(uint32_t nodeIdx, const std::vector<AABB>& primBounds) {
+        BVHNode& node = mNodes[nodeIdx];
+        AABB bounds;
+        for (uint32_t i = 0; i < node.primCount; i++)
+            bounds.Grow(primBounds[mPrimIndices[node.leftFirst + i]]);
+        node.boundsMin = bounds.min;
+        node.boundsMax = bounds.max;
+    }
+
+    void BVH::Subdivide(uint32_t rootIdx, const std::vector<AABB>& primBounds, const std::vector<glm::vec3>& centroids) {
+        struct Bin {
+            AABB bounds;
+            uint32_t count = 0;
+        };
+
+        struct Task {
+            uint32_t nodeIdx;
+            uint32_t depth;
+        };
+
+        std::vector<Task> tasks;
+        tasks.push_back({rootIdx, 0});
+
+        while (!tasks.empty()) {
+            Task task = tasks.back();
+            tasks.pop_back();
+
+            BVHNode& node = mNodes[task.nodeIdx];
+            if (node.primCount <= MaxLeafSize)
+                continue;
+
+            uint32_t first = node.leftFirst;
+            uint32_t count = node.primCount;
+
+            AABB centroidBounds;
+            for (uint32_t i = 0; i < count; i++)
+                centroidBounds.Grow(centroids[mPrimIndices[first + i]]);
+
+            // Find the best split plane by binning the centroids along each axis
+            int bestAxis = -1;
+            float bestPos = 0.0f;
+            float bestCost = FLT_MAX;
+            for (int axis = 0; axis < 3; axis++) {
+                float boundsMin = centroidBounds.min[axis];
+                float boundsMax = centroidBounds.max[axis];
+                if (boundsMin == boundsMax)
+                    continue;
+
+                Bin bins[BinCount];
+                float scale = BinCount / (boundsMax - boundsMin);
+                for (uint32_t i = 0; i < count; i++) {
+                    uint32_t primIdx = mPrimIndices[first + i];
+                    int binIdx = std::min(BinCount - 1, static_cast<int>((centroids[primIdx][axis] - boundsMin) * scale));
+                    bins[binIdx].count++;
+                    bins[binIdx].bounds.Grow(primBounds[primIdx]);
+                }
+
+                // Sweep from both sides to get the area and count on each side of every plane between bins
+                float leftArea[BinCount - 1], rightArea[BinCount - 1];
+                uint32_t leftCount[BinCount - 1], rightCount[BinCount - 1];
+                AABB leftBox, rightBox;
+                uint32_t leftSum = 0, rightSum = 0;
+                for (int i = 0; i < BinCount - 1; i++) {
+                    leftSum += bins[i].count;
+                    leftCount[i] = leftSum;
+                    leftBox.Grow(bins[i].bounds);
+                    leftArea[i] = leftBox.SurfaceArea();
+
+                    rightSum += bins[BinCount - 1 - i].count;
+                    rightCount[BinCount - 2 - i] = rightSum;
+                    rightBox.Grow(bins[BinCount - 1 - i].bounds);
+                    rightArea[BinCount - 2 - i] = rightBox.SurfaceArea();
+                }
+
+                for (int i = 0; i < BinCount - 1; i++) {
+                    float cost = leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i];
+                    if (cost < bestCost) {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestPos = boundsMin + (i + 1) / scale;
+                    }
+                }
+            }
+
+            AABB nodeBounds{node.boundsMin, node.boundsMax};
+            float leafCost = IntersectionCost * count;
+            float splitCost = TraversalCost + IntersectionCost * bestCost / nodeBounds.SurfaceArea();
+
+            uint32_t* begin = mPrimIndices.data() + first;
+            uint32_t* end = begin + count;
+            uint32_t* mid = nullptr;
+            if (task.depth >= MedianSplitDepth || bestAxis < 0) {
+                // Identical centroids can't be binned, and very deep nodes get halved to bound the tree depth
+                mid = begin + count / 2;
+                int axis = 0;
+                glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+                if (extent.y > extent.x) axis = 1;
+                if (extent.z > extent[axis]) axis = 2;
+                std::nth_element(begin, mid, end, [&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+            } else {
+                if (splitCost >= leafCost)
+                    continue;
+                mid = std::partition(begin, end, [&](uint32_t idx) { return centroids[idx][bestAxis] < bestPos; });
+            }
+
+            uint32_t leftCount = static_cast<uint32_t>(mid - begin);
+            if (leftCount == 0 || leftCount == count)
+                continue;
+
+            uint32_t leftIdx = mNodesUsed;
+            mNodesUsed += 2;
+            mNodes[leftIdx].leftFirst = first;
+            mNodes[leftIdx].primCount = leftCount;
+            mNodes[leftIdx + 1].leftFirst = first + leftCount;
+            mNodes[leftIdx + 1].primCount = count - leftCount;
+
+            node.leftFirst = leftIdx;
+            node.primCount = 0;
+
+            UpdateNodeBounds(leftIdx, primBounds);
+            UpdateNodeBounds(leftIdx + 1, primBounds);
+            tasks.push_back({leftIdx, task.depth + 1});
+            tasks.push_back({leftIdx + 1, task.depth + 1});
+        }
+    }
+
+}
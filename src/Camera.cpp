@@ -1,14 +1,16 @@
 #include <Camera.h>
 
 namespace Core {
+    Camera::Camera()
+        : Camera(glm::vec3(0), glm::vec2(16/9.0f, 1), 45.0f, 0.1f, 1000.0f) {
+    }
+
     Camera::Camera(const glm::vec3& position, const glm::vec2& viewport, float fov, float nearClip, float farClip)
         :mPosition(position), mViewport(viewport),
             mFOV(fov), mNearClip(nearClip), mFarClip(farClip),
             mAspectRatio(viewport.x/viewport.y) {
 
-        mProjectionMatrix = glm::perspective(mFOV, mAspectRatio, mNearClip, mFarClip);
-        mViewMatrix = glm::lookAt(mPosition, glm::vec3(0, 0, -1), glm::vec3(0, 1, 0));
-        mRayDirections.reserve(viewport.x * viewport.y);
+        UpdateMatrices();
     }
 
     void Camera::OnResize(const glm::vec2& viewport) {
@@ -18,20 +20,46 @@ namespace Core {
 
         mViewport = viewport;
         mAspectRatio = viewport.x/viewport.y;
-
-        mProjectionMatrix = glm::perspective(mFOV, mAspectRatio, mNearClip, mFarClip);
-        mInverseProjectionMatrix = glm::inverse(mProjectionMatrix);
-
-        mRayDirections.reserve(viewport.x * viewport.y);
-        CalculateRayDirections();
+        UpdateMatrices();
     }
 
     void Camera::SetPosition(const glm::vec3& position) {
         mPosition = position;
+        UpdateMatrices();
+    }
+
+    void Camera::SetRayGeneration(RayGeneration mode) {
+        mRayGeneration = mode;
+        if (mode == RayGeneration::Cached) {
+            CalculateRayDirections();
+        } else {
+            mRayDirections.clear();
+            mRayDirections.shrink_to_fit();
+        }
+    }
+
+    void Camera::UpdateMatrices() {
+        mProjectionMatrix = glm::perspective(mFOV, mAspectRatio, mNearClip, mFarClip);
+        mInverseProjectionMatrix = glm::inverse(mProjectionMatrix);
         mViewMatrix = glm::lookAt(mPosition, glm::vec3(0, 0, -1), glm::vec3(0, 1, 0));
+        mInverseViewMatrix = glm::inverse(mViewMatrix);
+
+        // The image plane is flat, so a direction is the center direction plus linear offsets along x and y.
+        // These are the same directions CalculateRayDirections gets from the matrices, before normalizing.
+        glm::vec4 center = mInverseProjectionMatrix * glm::vec4(0, 0, 1, 1);
+        glm::vec4 right = mInverseProjectionMatrix * glm::vec4(1, 0, 1, 1);
+        glm::vec4 top = mInverseProjectionMatrix * glm::vec4(0, 1, 1, 1);
+        glm::vec3 c = glm::vec3(center) / center.w;
+        mForward = glm::vec3(mInverseViewMatrix * glm::vec4(c, 0));
+        mRight = glm::vec3(mInverseViewMatrix * glm::vec4(glm::vec3(right) / right.w - c, 0));
+        mUp = glm::vec3(mInverseViewMatrix * glm::vec4(glm::vec3(top) / top.w - c, 0));
+
+        if (mRayGeneration == RayGeneration::Cached)
+            CalculateRayDirections();
     }
 
     void Camera::CalculateRayDirections() {
+        mRayDirections.resize(static_cast<size_t>(mViewport.x * mViewport.y));
         for (int y = 0; y < mViewport.y; y++) {
             for (int x = 0; x < mViewport.x; x++) {
                 glm::vec2 fragPos = glm::vec2(x / mViewport.x, y / mViewport.y);
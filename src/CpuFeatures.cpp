@@ -0,0 +1,48 @@
+#include <CpuFeatures.h>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #include <intrin.h>
+    #include <immintrin.h>
+#endif
+
+namespace RT {
+
+    bool CpuSupportsAVX2() {
+    #if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+
+        // AVX needs OS support for saving the ymm registers
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+            return false;
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    #elif defined(__x86_64__) || defined(__i386__)
+        return __builtin_cpu_supports("avx2");
+    #else
+        return false;
+    #endif
+    }
+
+    bool CpuSupportsFMA() {
+    #if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        int info[4];
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        bool fma = (info[2] & (1 << 12)) != 0;
+        return osxsave && avx && fma && (_xgetbv(0) & 6) == 6;
+    #elif defined(__x86_64__) || defined(__i386__)
+        return __builtin_cpu_supports("fma");
+    #else
+        return false;
+    #endif
+    }
+
+}
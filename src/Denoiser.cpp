@@ -0,0 +1,418 @@
+#include <Denoiser.h>
+#include <CpuFeatures.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define RT_X86 1
+    #include <immintrin.h>
+    #if defined(_MSC_VER)
+        #define RT_TARGET_AVX2_FMA
+    #else
+        #define RT_TARGET_AVX2_FMA __attribute__((target("avx2,fma")))
+    #endif
+#endif
+
+namespace RT {
+
+    static constexpr uint32_t RowsPerTask = 16;
+    static constexpr float Log2e = 1.44269504f;
+    // Tap weights don't go below 2^MinWeightLog2. Anything that small can't change the sum, and anything smaller
+    // would be a denormal, which costs a hundred cycles on x86.
+    static constexpr float MinWeightLog2 = -64.0f;
+
+    // 3x3 taps of the linear B-spline by |offset|. The 5x5 cubic one of the paper cost three times as much per
+    // iteration and lost to 3x3 from 4 samples per pixel up, where the sample variance steers the color weights.
+    static constexpr int KernelRadius = 1;
+    static constexpr float KernelWeights[KernelRadius + 1] = { 1.0f / 2.0f, 1.0f / 4.0f };
+    static constexpr float KernelWeightsLog2[KernelRadius + 1] = { -1.0f, -2.0f };
+    static constexpr int TapCount = (2 * KernelRadius + 1) * (2 * KernelRadius + 1) - 1;  // Without the center
+
+    static float Luminance(float r, float g, float b) {
+        return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+    }
+
+    // 2^x with the whole part of x as the exponent and the fraction as the mantissa, exact at whole numbers and at
+    // most 6% too large in between. The edge stopping weights only have to fall off smoothly, and this is three
+    // instructions where a polynomial took thirteen.
+    static float Exp2Weight(float x) {
+        float bits = std::max(x, MinWeightLog2) * 8388608.0f + 127.0f * 8388608.0f;
+        return std::bit_cast<float>(static_cast<int32_t>(bits));
+    }
+
+    // Everything one a-trous iteration reads and writes. Edge stopping terms are scaled by log2(e) so a tap's
+    // weight is a single exp2 of the kernel's log2 weight minus the sum of the terms.
+    struct AtrousPass {
+        const float* src[3];
+        float* dst[3];
+        const float* albedo[3];
+        const float* normal[3];
+        const float* depth;
+        float* deviation;       // Negative where the samples couldn't tell, see estimateDeviation
+        uint32_t width, height;
+        int step;
+        float colorSigma;
+        float normalWeight;     // log2(e) / sigma^2, normal and albedo differences are squared
+        float albedoWeight;
+        float depthSigma;
+        bool estimateDeviation; // First iteration, fills in the missing deviations from the 3x3 taps it reads anyway
+        bool remodulate;        // Last iteration, multiplies the albedo back in
+    };
+
+    // Depth change to the next pixel, taken from the flatter side so it doesn't jump at silhouettes
+    static void DepthSlopeScalar(const AtrousPass& pass, uint32_t x, uint32_t y, float& slopeX, float& slopeY) {
+        uint32_t p = x + y * pass.width;
+        const float* depth = pass.depth;
+        float left = x > 0 ? std::abs(depth[p] - depth[p - 1]) : 0.0f;
+        float right = x + 1 < pass.width ? std::abs(depth[p + 1] - depth[p]) : left;
+        float up = y > 0 ? std::abs(depth[p] - depth[p - pass.width]) : 0.0f;
+        float down = y + 1 < pass.height ? std::abs(depth[p + pass.width] - depth[p]) : up;
+        slopeX = x > 0 ? std::min(left, right) : right;
+        slopeY = y > 0 ? std::min(up, down) : down;
+    }
+
+    // Noise of the demodulated luminance from the 3x3 neighbourhood, which also holds real detail but is the only
+    // estimate a few samples allow
+    static float SpatialDeviationScalar(const AtrousPass& pass, uint32_t x, uint32_t y) {
+        uint32_t x0 = x > 0 ? x - 1 : 0, x1 = std::min(x + 1, pass.width - 1);
+        uint32_t y0 = y > 0 ? y - 1 : 0, y1 = std::min(y + 1, pass.height - 1);
+        float sum = 0.0f, sumSquares = 0.0f;
+        for (uint32_t qy = y0; qy <= y1; qy++) {
+            for (uint32_t qx = x0; qx <= x1; qx++) {
+                uint32_t q = qx + qy * pass.width;
+                float value = Luminance(pass.src[0][q], pass.src[1][q], pass.src[2][q]);
+                sum += value;
+                sumSquares += value * value;
+            }
+        }
+        float invCount = 1.0f / static_cast<float>((x1 - x0 + 1) * (y1 - y0 + 1));
+        float mean = sum * invCount;
+        return std::sqrt(std::max(sumSquares * invCount - mean * mean, 0.0f));
+    }
+
+    static void FilterPixelScalar(const AtrousPass& pass, uint32_t x, uint32_t y) {
+        uint32_t p = x + y * pass.width;
+        float color[3] = { pass.src[0][p], pass.src[1][p], pass.src[2][p] };
+        float luminance = Luminance(color[0], color[1], color[2]);
+        float deviation = pass.deviation[p];
+        if (pass.estimateDeviation && deviation < 0.0f) {
+            deviation = SpatialDeviationScalar(pass, x, y);
+            pass.deviation[p] = deviation;
+        }
+        float invColorSigma = Log2e / (pass.colorSigma * deviation + 1e-4f);
+        float depth = pass.depth[p];
+        float slopeX, slopeY;
+        DepthSlopeScalar(pass, x, y, slopeX, slopeY);
+
+        float centerWeight = KernelWeights[0] * KernelWeights[0];
+        float sum[3] = { color[0] * centerWeight, color[1] * centerWeight, color[2] * centerWeight };
+        float weightSum = centerWeight;
+        for (int ky = -KernelRadius; ky <= KernelRadius; ky++) {
+            int qy = static_cast<int>(y) + ky * pass.step;
+            if (qy < 0 || qy >= static_cast<int>(pass.height))
+                continue;
+            for (int kx = -KernelRadius; kx <= KernelRadius; kx++) {
+                int qx = static_cast<int>(x) + kx * pass.step;
+                if ((kx == 0 && ky == 0) || qx < 0 || qx >= static_cast<int>(pass.width))
+                    continue;
+                uint32_t q = static_cast<uint32_t>(qx) + static_cast<uint32_t>(qy) * pass.width;
+
+                float tap[3] = { pass.src[0][q], pass.src[1][q], pass.src[2][q] };
+                float exponent = std::abs(luminance - Luminance(tap[0], tap[1], tap[2])) * invColorSigma;
+                float normalDistance = 0.0f, albedoDistance = 0.0f;
+                for (int c = 0; c < 3; c++) {
+                    float dn = pass.normal[c][p] - pass.normal[c][q];
+                    float da = pass.albedo[c][p] - pass.albedo[c][q];
+                    normalDistance += dn * dn;
+                    albedoDistance += da * da;
+                }
+                exponent += normalDistance * pass.normalWeight + albedoDistance * pass.albedoWeight;
+                float expectedDepthChange = slopeX * static_cast<float>(std::abs(kx * pass.step)) +
+                                            slopeY * static_cast<float>(std::abs(ky * pass.step));
+                exponent += std::abs(depth - pass.depth[q]) * Log2e / (pass.depthSigma * expectedDepthChange + 1e-6f);
+
+                float weight = Exp2Weight(KernelWeightsLog2[std::abs(kx)] + KernelWeightsLog2[std::abs(ky)] - exponent);
+                for (int c = 0; c < 3; c++)
+                    sum[c] += tap[c] * weight;
+                weightSum += weight;
+            }
+        }
+
+        for (int c = 0; c < 3; c++) {
+            float filtered = sum[c] / weightSum;
+            if (pass.remodulate)
+                filtered *= std::max(pass.albedo[c][p], Denoiser::MinAlbedo);
+            pass.dst[c][p] = filtered;
+        }
+    }
+
+    static void FilterRowScalar(const AtrousPass& pass, uint32_t y) {
+        for (uint32_t x = 0; x < pass.width; x++)
+            FilterPixelScalar(pass, x, y);
+    }
+
+#ifdef RT_X86
+
+    // a * b + c in one rounding, the kernel is only picked on CPUs that report FMA next to AVX2.
+    RT_TARGET_AVX2_FMA static __m256 MulAddAVX2(__m256 a, __m256 b, __m256 c) {
+        return _mm256_fmadd_ps(a, b, c);
+    }
+
+    // c - a * b
+    RT_TARGET_AVX2_FMA static __m256 NegMulAddAVX2(__m256 a, __m256 b, __m256 c) {
+        return _mm256_fnmadd_ps(a, b, c);
+    }
+
+    // 1 / x from the approximate reciprocal and a Newton step, about 23 bits and much cheaper than a division
+    RT_TARGET_AVX2_FMA static __m256 ReciprocalAVX2(__m256 x) {
+        __m256 r = _mm256_rcp_ps(x);
+        return _mm256_mul_ps(r, _mm256_sub_ps(_mm256_set1_ps(2.0f), _mm256_mul_ps(x, r)));
+    }
+
+    // Same as Exp2Weight
+    RT_TARGET_AVX2_FMA static __m256 Exp2WeightAVX2(__m256 x) {
+        __m256 bits = MulAddAVX2(_mm256_max_ps(x, _mm256_set1_ps(MinWeightLog2)), _mm256_set1_ps(8388608.0f),
+                                 _mm256_set1_ps(127.0f * 8388608.0f));
+        return _mm256_castsi256_ps(_mm256_cvttps_epi32(bits));
+    }
+
+    // Pixels whose taps all lie inside the row go 8 at a time, the few next to the left and right border take the
+    // scalar path. So do the first and last row, their depth slope needs the border handling.
+    RT_TARGET_AVX2_FMA static void FilterRowAVX2(const AtrousPass& pass, uint32_t y) {
+        if (y == 0 || y + 1 == pass.height) {
+            FilterRowScalar(pass, y);
+            return;
+        }
+        uint32_t reach = KernelRadius * static_cast<uint32_t>(pass.step);
+        uint32_t x = 0;
+        for (; x < std::min(reach, pass.width); x++)
+            FilterPixelScalar(pass, x, y);
+
+        const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+        const __m256 lumR = _mm256_set1_ps(0.2126f), lumG = _mm256_set1_ps(0.7152f), lumB = _mm256_set1_ps(0.0722f);
+        const __m256 normalWeight = _mm256_set1_ps(pass.normalWeight);
+        const __m256 albedoWeight = _mm256_set1_ps(pass.albedoWeight);
+        const __m256 minAlbedo = _mm256_set1_ps(Denoiser::MinAlbedo);
+
+        // Taps in rows outside the image read the pixel's own row and get no weight, so every pixel runs the same code
+        int rowOffsets[2 * KernelRadius + 1];
+        __m256 rowMasks[2 * KernelRadius + 1];
+        for (int ky = -KernelRadius; ky <= KernelRadius; ky++) {
+            int qy = static_cast<int>(y) + ky * pass.step;
+            bool inside = qy >= 0 && qy < static_cast<int>(pass.height);
+            rowOffsets[ky + KernelRadius] = inside ? ky * pass.step * static_cast<int>(pass.width) : 0;
+            rowMasks[ky + KernelRadius] = _mm256_castsi256_ps(_mm256_set1_epi32(inside ? -1 : 0));
+        }
+
+        for (; x + 8 + reach <= pass.width; x += 8) {
+            uint32_t p = x + y * pass.width;
+            __m256 color[3], normal[3], albedo[3], sum[3];
+            for (int c = 0; c < 3; c++) {
+                color[c] = _mm256_loadu_ps(pass.src[c] + p);
+                normal[c] = _mm256_loadu_ps(pass.normal[c] + p);
+                albedo[c] = _mm256_loadu_ps(pass.albedo[c] + p);
+            }
+            __m256 luminance = MulAddAVX2(color[2], lumB, MulAddAVX2(color[1], lumG, _mm256_mul_ps(color[0], lumR)));
+            __m256 deviation = _mm256_loadu_ps(pass.deviation + p);
+            __m256 missing = _mm256_cmp_ps(deviation, _mm256_setzero_ps(), _CMP_LT_OQ);
+            if (pass.estimateDeviation && _mm256_movemask_ps(missing) != 0) {
+                __m256 sum = _mm256_setzero_ps(), sumSquares = _mm256_setzero_ps();
+                for (int ky = -1; ky <= 1; ky++) {
+                    for (int kx = -1; kx <= 1; kx++) {
+                        uint32_t q = static_cast<uint32_t>(static_cast<int>(p) + kx + ky * static_cast<int>(pass.width));
+                        __m256 value = MulAddAVX2(_mm256_loadu_ps(pass.src[2] + q), lumB,
+                            MulAddAVX2(_mm256_loadu_ps(pass.src[1] + q), lumG, _mm256_mul_ps(_mm256_loadu_ps(pass.src[0] + q), lumR)));
+                        sum = _mm256_add_ps(sum, value);
+                        sumSquares = MulAddAVX2(value, value, sumSquares);
+                    }
+                }
+                __m256 invCount = _mm256_set1_ps(1.0f / 9.0f);
+                __m256 mean = _mm256_mul_ps(sum, invCount);
+                __m256 variance = _mm256_sub_ps(_mm256_mul_ps(sumSquares, invCount), _mm256_mul_ps(mean, mean));
+                __m256 spatial = _mm256_sqrt_ps(_mm256_max_ps(variance, _mm256_setzero_ps()));
+                deviation = _mm256_blendv_ps(deviation, spatial, missing);
+                _mm256_storeu_ps(pass.deviation + p, deviation);
+            }
+            __m256 invColorSigma = _mm256_mul_ps(_mm256_set1_ps(Log2e),
+                ReciprocalAVX2(MulAddAVX2(_mm256_set1_ps(pass.colorSigma), deviation, _mm256_set1_ps(1e-4f))));
+
+            // The depth tolerance only depends on how far a tap is, so its reciprocal is taken once per distance
+            __m256 depth = _mm256_loadu_ps(pass.depth + p);
+            __m256 left = _mm256_and_ps(_mm256_sub_ps(depth, _mm256_loadu_ps(pass.depth + p - 1)), absMask);
+            __m256 right = _mm256_and_ps(_mm256_sub_ps(_mm256_loadu_ps(pass.depth + p + 1), depth), absMask);
+            __m256 up = _mm256_and_ps(_mm256_sub_ps(depth, _mm256_loadu_ps(pass.depth + p - pass.width)), absMask);
+            __m256 down = _mm256_and_ps(_mm256_sub_ps(_mm256_loadu_ps(pass.depth + p + pass.width), depth), absMask);
+            __m256 slopeX = _mm256_mul_ps(_mm256_min_ps(left, right), _mm256_set1_ps(pass.depthSigma * pass.step));
+            __m256 slopeY = _mm256_mul_ps(_mm256_min_ps(up, down), _mm256_set1_ps(pass.depthSigma * pass.step));
+            __m256 invDepthChange[KernelRadius + 1][KernelRadius + 1];
+            for (int ay = 0; ay <= KernelRadius; ay++) {
+                for (int ax = ay == 0 ? 1 : 0; ax <= KernelRadius; ax++) {
+                    __m256 expected = MulAddAVX2(slopeX, _mm256_set1_ps(static_cast<float>(ax)),
+                        MulAddAVX2(slopeY, _mm256_set1_ps(static_cast<float>(ay)), _mm256_set1_ps(1e-6f)));
+                    invDepthChange[ay][ax] = _mm256_mul_ps(_mm256_set1_ps(Log2e), ReciprocalAVX2(expected));
+                }
+            }
+
+            // The first hits decide most of a tap's weight and go first for all taps, then the color term, so the
+            // values each half needs fit in registers
+            __m256 tapWeightLog2[TapCount];
+            int tap = 0;
+            for (int ky = -KernelRadius; ky <= KernelRadius; ky++) {
+                for (int kx = -KernelRadius; kx <= KernelRadius; kx++) {
+                    if (kx == 0 && ky == 0)
+                        continue;
+                    uint32_t q = static_cast<uint32_t>(static_cast<int>(p) + rowOffsets[ky + KernelRadius] + kx * pass.step);
+                    __m256 normalDistance = _mm256_setzero_ps(), albedoDistance = _mm256_setzero_ps();
+                    for (int c = 0; c < 3; c++) {
+                        __m256 dn = _mm256_sub_ps(normal[c], _mm256_loadu_ps(pass.normal[c] + q));
+                        __m256 da = _mm256_sub_ps(albedo[c], _mm256_loadu_ps(pass.albedo[c] + q));
+                        normalDistance = MulAddAVX2(dn, dn, normalDistance);
+                        albedoDistance = MulAddAVX2(da, da, albedoDistance);
+                    }
+                    __m256 depthChange = _mm256_and_ps(_mm256_sub_ps(depth, _mm256_loadu_ps(pass.depth + q)), absMask);
+                    __m256 weightLog2 = _mm256_set1_ps(KernelWeightsLog2[std::abs(kx)] + KernelWeightsLog2[std::abs(ky)]);
+                    weightLog2 = NegMulAddAVX2(normalDistance, normalWeight, weightLog2);
+                    weightLog2 = NegMulAddAVX2(albedoDistance, albedoWeight, weightLog2);
+                    tapWeightLog2[tap++] = NegMulAddAVX2(depthChange, invDepthChange[std::abs(ky)][std::abs(kx)], weightLog2);
+                }
+            }
+
+            __m256 weightSum = _mm256_set1_ps(KernelWeights[0] * KernelWeights[0]);
+            for (int c = 0; c < 3; c++)
+                sum[c] = _mm256_mul_ps(color[c], weightSum);
+            tap = 0;
+            for (int ky = -KernelRadius; ky <= KernelRadius; ky++) {
+                for (int kx = -KernelRadius; kx <= KernelRadius; kx++) {
+                    if (kx == 0 && ky == 0)
+                        continue;
+                    uint32_t q = static_cast<uint32_t>(static_cast<int>(p) + rowOffsets[ky + KernelRadius] + kx * pass.step);
+                    __m256 tapColor[3];
+                    for (int c = 0; c < 3; c++)
+                        tapColor[c] = _mm256_loadu_ps(pass.src[c] + q);
+                    __m256 tapLuminance = MulAddAVX2(tapColor[2], lumB, MulAddAVX2(tapColor[1], lumG, _mm256_mul_ps(tapColor[0], lumR)));
+                    __m256 colorChange = _mm256_and_ps(_mm256_sub_ps(luminance, tapLuminance), absMask);
+                    __m256 weight = Exp2WeightAVX2(NegMulAddAVX2(colorChange, invColorSigma, tapWeightLog2[tap++]));
+                    weight = _mm256_and_ps(weight, rowMasks[ky + KernelRadius]);
+                    for (int c = 0; c < 3; c++)
+                        sum[c] = MulAddAVX2(tapColor[c], weight, sum[c]);
+                    weightSum = _mm256_add_ps(weightSum, weight);
+                }
+            }
+
+            __m256 invWeightSum = ReciprocalAVX2(weightSum);
+            for (int c = 0; c < 3; c++) {
+                __m256 filtered = _mm256_mul_ps(sum[c], invWeightSum);
+                if (pass.remodulate)
+                    filtered = _mm256_mul_ps(filtered, _mm256_max_ps(albedo[c], minAlbedo));
+                _mm256_storeu_ps(pass.dst[c] + p, filtered);
+            }
+        }
+
+        for (; x < pass.width; x++)
+            FilterPixelScalar(pass, x, y);
+    }
+
+#endif
+
+    using FilterRowFn = void (*)(const AtrousPass& pass, uint32_t y);
+
+    struct FilterKernel {
+        FilterRowFn filter;
+        const char* name;
+    };
+
+    static FilterKernel SelectFilterKernel() {
+    #ifdef RT_X86
+        if (CpuSupportsAVX2() && CpuSupportsFMA())
+            return { FilterRowAVX2, "AVX2+FMA" };
+    #endif
+        return { FilterRowScalar, "Scalar" };
+    }
+
+    static const FilterKernel& GetKernel() {
+        static const FilterKernel kernel = SelectFilterKernel();
+        return kernel;
+    }
+
+    const char* Denoiser::GetKernelName() {
+        return GetKernel().name;
+    }
+
+    void Denoiser::Resize(uint32_t width, uint32_t height) {
+        if (width == mWidth && height == mHeight)
+            return;
+        mWidth = width;
+        mHeight = height;
+        size_t pixelCount = static_cast<size_t>(width) * height;
+        for (Core::AlignedVector<float>& plane : mColor)
+            plane.assign(pixelCount, 0.0f);
+        for (auto& buffer : mFiltered) {
+            for (Core::AlignedVector<float>& plane : buffer)
+                plane.assign(pixelCount, 0.0f);
+        }
+        mDeviation.assign(pixelCount, -1.0f);
+        mResult = 0;
+    }
+
+    void Denoiser::Denoise(const GBuffer& gbuffer, const DenoiserSettings& settings, ThreadPool& threadPool) {
+        const float* albedo[3] = { gbuffer.albedoR.data(), gbuffer.albedoG.data(), gbuffer.albedoB.data() };
+        mResult = 0;
+        if (settings.iterations <= 0) {
+            for (int c = 0; c < 3; c++) {
+                for (size_t p = 0; p < mColor[c].size(); p++)
+                    mFiltered[0][c][p] = mColor[c][p] * std::max(albedo[c][p], MinAlbedo);
+            }
+            return;
+        }
+
+        AtrousPass pass;
+        for (int c = 0; c < 3; c++)
+            pass.albedo[c] = albedo[c];
+        pass.normal[0] = gbuffer.normalX.data();
+        pass.normal[1] = gbuffer.normalY.data();
+        pass.normal[2] = gbuffer.normalZ.data();
+        pass.depth = gbuffer.depth.data();
+        pass.deviation = mDeviation.data();
+        pass.width = mWidth;
+        pass.height = mHeight;
+        pass.normalWeight = Log2e / (settings.normalSigma * settings.normalSigma);
+        pass.albedoWeight = Log2e / (settings.albedoSigma * settings.albedoSigma);
+        pass.depthSigma = settings.depthSigma;
+
+        const FilterKernel& kernel = GetKernel();
+        uint32_t taskCount = (mHeight + RowsPerTask - 1) / RowsPerTask;
+        for (int iteration = 0; iteration < settings.iterations; iteration++) {
+            // The first iteration reads the color as set, the ones after ping-pong between the filtered buffers
+            uint32_t target = static_cast<uint32_t>(iteration) & 1;
+            for (int c = 0; c < 3; c++) {
+                pass.src[c] = iteration == 0 ? mColor[c].data() : mFiltered[target ^ 1][c].data();
+                pass.dst[c] = mFiltered[target][c].data();
+            }
+            pass.step = 1 << iteration;
+            // Every iteration removes noise, so the next one can tell smaller differences from it
+            pass.colorSigma = settings.colorSigma / static_cast<float>(1 << iteration);
+            pass.estimateDeviation = iteration == 0;
+            pass.remodulate = iteration == settings.iterations - 1;
+            threadPool.ParallelFor(taskCount, [&](uint32_t task, uint32_t) {
+                uint32_t y1 = std::min((task + 1) * RowsPerTask, mHeight);
+                for (uint32_t y = task * RowsPerTask; y < y1; y++)
+                    kernel.filter(pass, y);
+            });
+            mResult = target;
+        }
+    }
+
+    size_t Denoiser::GetMemoryUsage() const {
+        size_t floats = mDeviation.capacity();
+        for (const Core::AlignedVector<float>& plane : mColor)
+            floats += plane.capacity();
+        for (const auto& buffer : mFiltered) {
+            for (const Core::AlignedVector<float>& plane : buffer)
+                floats += plane.capacity();
+        }
+        return floats * sizeof(float);
+    }
+
+}
@@ -0,0 +1,23 @@
+#include <GBuffer.h>
+
+#include <algorithm>
+#include <initializer_list>
+
+namespace RT {
+
+    void GBuffer::Resize(uint32_t pixelCount) {
+        for (Core::AlignedVector<float>* plane : { &albedoR, &albedoG, &albedoB, &normalX, &normalY, &normalZ, &depth })
+            plane->assign(pixelCount, 0.0f);
+    }
+
+    void GBuffer::Clear() {
+        for (Core::AlignedVector<float>* plane : { &albedoR, &albedoG, &albedoB, &normalX, &normalY, &normalZ, &depth })
+            std::fill(plane->begin(), plane->end(), 0.0f);
+    }
+
+    size_t GBuffer::GetMemoryUsage() const {
+        return (albedoR.capacity() + albedoG.capacity() + albedoB.capacity() + normalX.capacity() + normalY.capacity() +
+                normalZ.capacity() + depth.capacity()) * sizeof(float);
+    }
+
+}
@@ -1,5 +1,7 @@
 #include <Image.h>
 
+#include <cstring>
+
 namespace Core {
 
     void DrawPixel(Image* image, int pixelPos, const glm::vec4& color) {
@@ -24,4 +26,12 @@ namespace Core {
         image->pixels[pixelPos + 2] = b;
     }
 
+    void CopyRegion(const Image& source, Image* destination, const ImageRegion& region) {
+        size_t rowBytes = static_cast<size_t>(region.width) * source.comps;
+        for (uint32_t y = region.y; y < region.y + region.height; y++) {
+            size_t offset = (static_cast<size_t>(y) * source.width + region.x) * source.comps;
+            std::memcpy(destination->pixels.data() + offset, source.pixels.data() + offset, rowBytes);
+        }
+    }
+
 }
@@ -3,6 +3,8 @@
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <stbi/stb_image_write.h>
 
+#include <iostream>
+
 namespace Core {
 
     ImagePNG::ImagePNG(const Image* image) {
@@ -22,11 +24,15 @@ namespace Core {
         }
     }
 
-    void ImagePNG::Save(const std::string& fileName) {
+    bool ImagePNG::Save(const std::string& fileName) {
         stbi_flip_vertically_on_write(mFlipV);
-        stbi_write_png((fileName + ".png").data(), mImage->width,
-                        mImage->height, mImage->comps,
-                        mImage->pixels.data(), mImage->width*mImage->comps);
+        if (!stbi_write_png((fileName + ".png").data(), mImage->width,
+                            mImage->height, mImage->comps,
+                            mImage->pixels.data(), mImage->width*mImage->comps)) {
+            std::cerr << "Failed to write " << fileName << ".png\n";
+            return false;
+        }
+        return true;
     }
 
     void ImagePNG::FlipVertical(bool enabled) {
@@ -0,0 +1,128 @@
+#include <InstanceBVH.h>
+
+#include <cmath>
+#include <iostream>
+
+namespace RT {
+
+    void InstanceBVH::Build(const Core::Scene& scene, const std::vector<MeshBVH>& meshBVHs) {
+        mMeshBVHs = &meshBVHs;
+
+        std::vector<Placement> placements;
+        std::vector<AABB> bounds;
+        placements.reserve(scene.instances.size());
+        bounds.reserve(scene.instances.size());
+
+        auto place = [&](const glm::mat4& transform, uint32_t meshIndex, int materialIndex) {
+            AABB meshBounds = meshBVHs[meshIndex].GetBounds();
+            if (meshBounds.min.x > meshBounds.max.x)
+                return;
+
+            glm::mat3 linear(transform);
+            float determinant = glm::dot(linear[0], glm::cross(linear[1], linear[2]));
+            if (!std::isfinite(determinant) || determinant == 0.0f) {
+                std::cerr << "Skipping an instance of mesh " << meshIndex << " with a singular transform\n";
+                return;
+            }
+
+            AABB worldBounds;
+            for (int corner = 0; corner < 8; corner++) {
+                glm::vec3 point((corner & 1) ? meshBounds.max.x : meshBounds.min.x,
+                                (corner & 2) ? meshBounds.max.y : meshBounds.min.y,
+                                (corner & 4) ? meshBounds.max.z : meshBounds.min.z);
+                worldBounds.Grow(glm::vec3(transform * glm::vec4(point, 1.0f)));
+            }
+
+            glm::mat3 inverseLinear = glm::inverse(linear);
+            Placement placement;
+            placement.linear = inverseLinear;
+            placement.offset = -(inverseLinear * glm::vec3(transform[3]));
+            placement.meshIndex = meshIndex;
+            placement.materialIndex = materialIndex >= 0 ? materialIndex : scene.meshes[meshIndex].materialIndex;
+            placements.push_back(placement);
+            bounds.push_back(worldBounds);
+        };
+
+        std::vector<uint8_t> instanced(scene.meshes.size(), 0);
+        for (const Core::Instance& instance : scene.instances) {
+            if (instance.meshIndex >= scene.meshes.size()) {
+                std::cerr << "Skipping an instance of mesh " << instance.meshIndex << ", the scene only has " << scene.meshes.size() << "\n";
+                continue;
+            }
+            instanced[instance.meshIndex] = 1;
+            place(instance.transform, instance.meshIndex, instance.materialIndex);
+        }
+        for (uint32_t mesh = 0; mesh < scene.meshes.size(); mesh++) {
+            if (!instanced[mesh])
+                place(glm::mat4(1.0f), mesh, -1);
+        }
+
+        mBVH.Build(bounds);
+
+        // Leaves reference consecutive placements, so store them in that order like the spheres
+        const std::vector<uint32_t>& order = mBVH.GetPrimitiveIndices();
+        mPlacements.resize(placements.size());
+        for (size_t slot = 0; slot < placements.size(); slot++)
+            mPlacements[slot] = placements[order[slot]];
+    }
+
+    InstanceBVH::Hit InstanceBVH::Intersect(const Core::Scene& scene, const glm::vec3& org, const glm::vec3& dir, float& tmax,
+                                            uint64_t& nodeVisits, uint64_t& intersectionTests) const {
+        Hit hit;
+        nodeVisits += mBVH.Traverse(org, dir, tmax, [&](uint32_t first, uint32_t count) {
+            for (uint32_t slot = first; slot < first + count; slot++) {
+                const Placement& placement = mPlacements[slot];
+                // The direction isn't renormalized, so distances in object space are the same as in world space
+                glm::vec3 localOrg = placement.linear * org + placement.offset;
+                glm::vec3 localDir = placement.linear * dir;
+                int triangle = (*mMeshBVHs)[placement.meshIndex].Intersect(scene.meshes[placement.meshIndex], localOrg, localDir, tmax,
+                                                                           nodeVisits, intersectionTests);
+                if (triangle >= 0) {
+                    hit.instance = static_cast<int>(slot);
+                    hit.triangle = triangle;
+                }
+            }
+        });
+        return hit;
+    }
+
+    bool InstanceBVH::Occluded(const Core::Scene& scene, const glm::vec3& org, const glm::vec3& dir, float tmax,
+                               uint64_t& nodeVisits, uint64_t& intersectionTests) const {
+        bool occluded = false;
+        nodeVisits += mBVH.Traverse(org, dir, tmax, [&](uint32_t first, uint32_t count) {
+            for (uint32_t slot = first; slot < first + count; slot++) {
+                const Placement& placement = mPlacements[slot];
+                glm::vec3 localOrg = placement.linear * org + placement.offset;
+                glm::vec3 localDir = placement.linear * dir;
+                if ((*mMeshBVHs)[placement.meshIndex].Occluded(scene.meshes[placement.meshIndex], localOrg, localDir, tmax,
+                                                                nodeVisits, intersectionTests)) {
+                    occluded = true;
+                    tmax = -1.0f;
+                    return;
+                }
+            }
+        });
+        return occluded;
+    }
+
+    glm::vec3 InstanceBVH::GetNormal(const Core::Scene& scene, const Hit& hit, const glm::vec3& dir) const {
+        const Placement& placement = mPlacements[hit.instance];
+        const Core::Mesh& mesh = scene.meshes[placement.meshIndex];
+        const uint32_t* indices = &mesh.indices[3 * static_cast<size_t>(hit.triangle)];
+        glm::vec3 v0 = mesh.GetVertex(indices[0]);
+        glm::vec3 objectNormal = glm::cross(mesh.GetVertex(indices[1]) - v0, mesh.GetVertex(indices[2]) - v0);
+
+        // Normals transform by the inverse transpose of the object to world matrix, the transpose of the stored one
+        glm::vec3 normal = glm::normalize(glm::transpose(placement.linear) * objectNormal);
+        // Triangles are two sided, shade the side the ray came from
+        if (glm::dot(normal, dir) > 0.0f)
+            normal = -normal;
+        return normal;
+    }
+
+    size_t InstanceBVH::GetMemoryUsage() const {
+        return mBVH.GetNodes().size() * sizeof(BVHNode) + mBVH.GetPrimitiveIndices().size() * sizeof(uint32_t) +
+               mPlacements.size() * sizeof(Placement);
+    }
+
+}
@@ -0,0 +1,143 @@
+#include <LightSampler.h>
+#include <Sampling.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include <glm/gtc/constants.hpp>
+
+namespace RT {
+
+    static float Luminance(const glm::vec3& color) {
+        return glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+    }
+
+    // Radiance times projected area, comparable to the intensity of a point light
+    float LightSampler::SphereWeight(const Core::Scene& scene, const Core::Sphere& sphere) const {
+        if (sphere.materialIndex < 0 || static_cast<size_t>(sphere.materialIndex) >= scene.materials.size())
+            return 0.0f;
+        const Core::Material& mat = scene.materials[sphere.materialIndex];
+        float radiance = Luminance(mat.emissionColor) * mat.emissionStrength;
+        return std::max(radiance, 0.0f) * glm::pi<float>() * sphere.radius * sphere.radius;
+    }
+
+    void LightSampler::Build(const Core::Scene& scene) {
+        mLights.clear();
+        mCdf.clear();
+        mTotalWeight = 0.0f;
+
+        auto add = [this](LightType type, uint32_t index, float weight) {
+            if (!(weight > 0.0f) || !std::isfinite(weight))
+                return;
+            mTotalWeight += weight;
+            mLights.push_back({type, index});
+            mCdf.push_back(mTotalWeight);
+        };
+        for (uint32_t i = 0; i < scene.spheres.size(); i++)
+            add(LightType::Sphere, i, SphereWeight(scene, scene.spheres[i]));
+        for (uint32_t i = 0; i < scene.directionalLights.size(); i++)
+            add(LightType::Directional, i, Luminance(scene.directionalLights[i].color) * scene.directionalLights[i].intensity);
+        for (uint32_t i = 0; i < scene.pointLights.size(); i++)
+            add(LightType::Point, i, Luminance(scene.pointLights[i].color) * scene.pointLights[i].intensity);
+    }
+
+    float LightSampler::SelectionPdf(float weight) const {
+        return 0.5f * weight / mTotalWeight + 0.5f / static_cast<float>(mLights.size());
+    }
+
+    // Cone of directions from position that hit the sphere, false from inside of it
+    static bool SphereCone(const glm::vec3& position, const Core::Sphere& sphere, glm::vec3& axis, float& distanceSquared, float& oneMinusCosMax) {
+        glm::vec3 toCenter = sphere.position - position;
+        distanceSquared = glm::dot(toCenter, toCenter);
+        float radiusSquared = sphere.radius * sphere.radius;
+        if (distanceSquared <= radiusSquared)
+            return false;
+
+        axis = toCenter / std::sqrt(distanceSquared);
+        float sinMaxSquared = radiusSquared / distanceSquared;
+        float cosMax = std::sqrt(1.0f - sinMaxSquared);
+        // 1 - cosMax written so it keeps its precision for small, distant spheres
+        oneMinusCosMax = sinMaxSquared / (1.0f + cosMax);
+        return true;
+    }
+
+    bool LightSampler::Sample(const Core::Scene& scene, const glm::vec3& position, float uLight, float u0, float u1, LightSample& sample) const {
+        if (mLights.empty())
+            return false;
+
+        // The first half of uLight's range picks uniformly, the second half by power
+        size_t lightIndex;
+        if (uLight < 0.5f)
+            lightIndex = static_cast<size_t>(2.0f * uLight * static_cast<float>(mLights.size()));
+        else
+            lightIndex = std::upper_bound(mCdf.begin(), mCdf.end(), (2.0f * uLight - 1.0f) * mTotalWeight) - mCdf.begin();
+        lightIndex = std::min(lightIndex, mLights.size() - 1);
+        float selectionPdf = SelectionPdf(mCdf[lightIndex] - (lightIndex > 0 ? mCdf[lightIndex - 1] : 0.0f));
+        const Light& light = mLights[lightIndex];
+
+        switch (light.type) {
+        case LightType::Sphere: {
+            const Core::Sphere& sphere = scene.spheres[light.index];
+            glm::vec3 axis;
+            float distanceSquared, oneMinusCosMax;
+            if (!SphereCone(position, sphere, axis, distanceSquared, oneMinusCosMax))
+                return false;
+
+            float cosTheta = 1.0f - u0 * oneMinusCosMax;
+            float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+            float phi = 2.0f * glm::pi<float>() * u1;
+            glm::vec3 tangent, bitangent;
+            OrthonormalBasis(axis, tangent, bitangent);
+            sample.direction = glm::normalize(tangent * (sinTheta * std::cos(phi)) + bitangent * (sinTheta * std::sin(phi)) + axis * cosTheta);
+
+            // Distance to the near side of the sphere along the sampled direction
+            float projection = std::sqrt(distanceSquared) * cosTheta;
+            float discriminant = sphere.radius * sphere.radius - (distanceSquared - projection * projection);
+            sample.distance = projection - std::sqrt(std::max(discriminant, 0.0f));
+
+            const Core::Material& mat = scene.materials[sphere.materialIndex];
+            sample.radiance = mat.emissionColor * mat.emissionStrength;
+            sample.pdf = selectionPdf / (2.0f * glm::pi<float>() * oneMinusCosMax);
+            sample.isDelta = false;
+            return true;
+        }
+        case LightType::Directional: {
+            const Core::DirectionalLight& directional = scene.directionalLights[light.index];
+            sample.direction = -glm::normalize(directional.direction);
+            sample.distance = FLT_MAX;
+            sample.radiance = directional.color * directional.intensity;
+            sample.pdf = selectionPdf;
+            sample.isDelta = true;
+            return true;
+        }
+        case LightType::Point: {
+            const Core::PointLight& point = scene.pointLights[light.index];
+            glm::vec3 toLight = point.Position - position;
+            float distanceSquared = glm::dot(toLight, toLight);
+            if (distanceSquared <= 0.0f)
+                return false;
+            sample.distance = std::sqrt(distanceSquared);
+            sample.direction = toLight / sample.distance;
+            sample.radiance = point.color * point.intensity / distanceSquared;
+            sample.pdf = selectionPdf;
+            sample.isDelta = true;
+            return true;
+        }
+        }
+        return false;
+    }
+
+    float LightSampler::SpherePdf(const Core::Scene& scene, uint32_t sphereIndex, const glm::vec3& position) const {
+        if (mTotalWeight <= 0.0f)
+            return 0.0f;
+        const Core::Sphere& sphere = scene.spheres[sphereIndex];
+        float weight = SphereWeight(scene, sphere);
+        glm::vec3 axis;
+        float distanceSquared, oneMinusCosMax;
+        if (!(weight > 0.0f) || !SphereCone(position, sphere, axis, distanceSquared, oneMinusCosMax))
+            return 0.0f;
+        return SelectionPdf(weight) / (2.0f * glm::pi<float>() * oneMinusCosMax);
+    }
+
+}
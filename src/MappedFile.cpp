@@ -0,0 +1,113 @@
+#include <MappedFile.h>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace Core {
+
+    MappedFile::MappedFile(const std::string& path) {
+        Open(path);
+    }
+
+    MappedFile::~MappedFile() {
+        Close();
+    }
+
+#ifdef _WIN32
+
+    bool MappedFile::Open(const std::string& path) {
+        Close();
+
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+            CloseHandle(file);
+            return false;
+        }
+
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) {
+            CloseHandle(file);
+            return false;
+        }
+
+        void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!data) {
+            CloseHandle(mapping);
+            CloseHandle(file);
+            return false;
+        }
+
+        mFileHandle = file;
+        mMappingHandle = mapping;
+        mData = static_cast<const uint8_t*>(data);
+        mSize = static_cast<size_t>(size.QuadPart);
+        return true;
+    }
+
+    void MappedFile::Close() {
+        if (mData)
+            UnmapViewOfFile(mData);
+        if (mMappingHandle)
+            CloseHandle(mMappingHandle);
+        if (mFileHandle)
+            CloseHandle(mFileHandle);
+        mData = nullptr;
+        mSize = 0;
+        mFileHandle = nullptr;
+        mMappingHandle = nullptr;
+    }
+
+#else
+
+    bool MappedFile::Open(const std::string& path) {
+        Close();
+
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            close(fd);
+            return false;
+        }
+
+        void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        // Mapped files are mostly read front to back, let the kernel read ahead
+        madvise(data, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+
+        mFileDescriptor = fd;
+        mData = static_cast<const uint8_t*>(data);
+        mSize = static_cast<size_t>(info.st_size);
+        return true;
+    }
+
+    void MappedFile::Close() {
+        if (mData)
+            munmap(const_cast<uint8_t*>(mData), mSize);
+        if (mFileDescriptor >= 0)
+            close(mFileDescriptor);
+        mData = nullptr;
+        mSize = 0;
+        mFileDescriptor = -1;
+    }
+
+#endif
+
+}
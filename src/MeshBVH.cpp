@@ -0,0 +1,132 @@
+#include <MeshBVH.h>
+
+#include <utility>
+
+namespace RT {
+
+    TriangleRay::TriangleRay(const glm::vec3& origin, const glm::vec3& dir)
+        : org(origin) {
+        glm::vec3 absDir = glm::abs(dir);
+        kz = absDir.x > absDir.y ? (absDir.x > absDir.z ? 0 : 2) : (absDir.y > absDir.z ? 1 : 2);
+        kx = (kz + 1) % 3;
+        ky = (kx + 1) % 3;
+        // Keep the winding of the triangle when the ray points down the kz axis
+        if (dir[kz] < 0.0f)
+            std::swap(kx, ky);
+
+        sx = dir[kx] / dir[kz];
+        sy = dir[ky] / dir[kz];
+        sz = 1.0f / dir[kz];
+    }
+
+    bool IntersectTriangle(const TriangleRay& ray, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, float tmax, float& t) {
+        const glm::vec3 a = v0 - ray.org;
+        const glm::vec3 b = v1 - ray.org;
+        const glm::vec3 c = v2 - ray.org;
+
+        const float ax = a[ray.kx] - ray.sx * a[ray.kz];
+        const float ay = a[ray.ky] - ray.sy * a[ray.kz];
+        const float bx = b[ray.kx] - ray.sx * b[ray.kz];
+        const float by = b[ray.ky] - ray.sy * b[ray.kz];
+        const float cx = c[ray.kx] - ray.sx * c[ray.kz];
+        const float cy = c[ray.ky] - ray.sy * c[ray.kz];
+
+        float u = cx * by - cy * bx;
+        float v = ax * cy - ay * cx;
+        float w = bx * ay - by * ax;
+
+        // A ray exactly on an edge gets the edge functions again in double, so both triangles sharing it agree
+        if (u == 0.0f || v == 0.0f || w == 0.0f) {
+            u = static_cast<float>(static_cast<double>(cx) * by - static_cast<double>(cy) * bx);
+            v = static_cast<float>(static_cast<double>(ax) * cy - static_cast<double>(ay) * cx);
+            w = static_cast<float>(static_cast<double>(bx) * ay - static_cast<double>(by) * ax);
+        }
+
+        if ((u < 0.0f || v < 0.0f || w < 0.0f) && (u > 0.0f || v > 0.0f || w > 0.0f))
+            return false;
+        float det = u + v + w;
+        if (det == 0.0f)
+            return false;
+
+        // Distance scaled by det, compared against (0, tmax] without dividing. A negative det is a back face.
+        const float az = ray.sz * a[ray.kz];
+        const float bz = ray.sz * b[ray.kz];
+        const float cz = ray.sz * c[ray.kz];
+        float scaledT = u * az + v * bz + w * cz;
+        if (det > 0.0f ? (scaledT <= 0.0f || scaledT > tmax * det) : (scaledT >= 0.0f || scaledT < tmax * det))
+            return false;
+
+        t = scaledT / det;
+        return true;
+    }
+
+    void MeshBVH::Build(const Core::Mesh& mesh) {
+        uint32_t triangleCount = mesh.GetTriangleCount();
+        std::vector<AABB> bounds(triangleCount);
+        for (uint32_t i = 0; i < triangleCount; i++) {
+            for (int corner = 0; corner < 3; corner++)
+                bounds[i].Grow(mesh.GetVertex(mesh.indices[3 * i + corner]));
+        }
+        mBVH.Build(bounds);
+
+        // Leaves reference consecutive triangles, so store them in that order
+        const std::vector<uint32_t>& triangleIndices = mBVH.GetPrimitiveIndices();
+        mIndices.resize(3 * static_cast<size_t>(triangleCount));
+        for (uint32_t slot = 0; slot < triangleCount; slot++) {
+            uint32_t triangle = triangleIndices[slot];
+            mIndices[3 * slot + 0] = mesh.indices[3 * triangle + 0];
+            mIndices[3 * slot + 1] = mesh.indices[3 * triangle + 1];
+            mIndices[3 * slot + 2] = mesh.indices[3 * triangle + 2];
+        }
+    }
+
+    int MeshBVH::Intersect(const Core::Mesh& mesh, const glm::vec3& org, const glm::vec3& dir, float& tmax,
+                           uint64_t& nodeVisits, uint64_t& intersectionTests) const {
+        TriangleRay triangleRay(org, dir);
+        int hitSlot = -1;
+        nodeVisits += mBVH.Traverse(org, dir, tmax, [&](uint32_t first, uint32_t count) {
+            for (uint32_t slot = first; slot < first + count; slot++) {
+                const uint32_t* triangle = &mIndices[3 * static_cast<size_t>(slot)];
+                float t;
+                if (IntersectTriangle(triangleRay, mesh.GetVertex(triangle[0]), mesh.GetVertex(triangle[1]), mesh.GetVertex(triangle[2]), tmax, t)) {
+                    tmax = t;
+                    hitSlot = static_cast<int>(slot);
+                }
+            }
+            intersectionTests += count;
+        });
+        return hitSlot >= 0 ? static_cast<int>(mBVH.GetPrimitiveIndices()[hitSlot]) : -1;
+    }
+
+    bool MeshBVH::Occluded(const Core::Mesh& mesh, const glm::vec3& org, const glm::vec3& dir, float tmax,
+                           uint64_t& nodeVisits, uint64_t& intersectionTests) const {
+        TriangleRay triangleRay(org, dir);
+        bool occluded = false;
+        nodeVisits += mBVH.Traverse(org, dir, tmax, [&](uint32_t first, uint32_t count) {
+            for (uint32_t slot = first; slot < first + count; slot++) {
+                const uint32_t* triangle = &mIndices[3 * static_cast<size_t>(slot)];
+                float t;
+                intersectionTests++;
+                if (IntersectTriangle(triangleRay, mesh.GetVertex(triangle[0]), mesh.GetVertex(triangle[1]), mesh.GetVertex(triangle[2]), tmax, t)) {
+                    occluded = true;
+                    tmax = -1.0f;
+                    return;
+                }
+            }
+        });
+        return occluded;
+    }
+
+    AABB MeshBVH::GetBounds() const {
+        if (mBVH.IsEmpty())
+            return AABB{};
+        const BVHNode& root = mBVH.GetNodes()[0];
+        return AABB{root.boundsMin, root.boundsMax};
+    }
+
+    size_t MeshBVH::GetMemoryUsage() const {
+        return mBVH.GetNodes().size() * sizeof(BVHNode) + mBVH.GetPrimitiveIndices().size() * sizeof(uint32_t) +
+               mIndices.size() * sizeof(uint32_t);
+    }
+
+}
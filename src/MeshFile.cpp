@@ -0,0 +1,453 @@
+#include <MeshFile.h>
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+namespace Core {
+
+    // Reads a file through a fixed size buffer, lines longer than the buffer make it grow
+    class ChunkedReader {
+    public:
+        static constexpr size_t ChunkSize = 1 << 20;
+
+        explicit ChunkedReader(const std::string& path)
+            : mFile(path, std::ios::binary | std::ios::ate), mBuffer(ChunkSize) {
+            if (mFile.is_open()) {
+                mFileSize = static_cast<uint64_t>(mFile.tellg());
+                mFile.seekg(0);
+            }
+        }
+
+        bool IsOpen() const { return static_cast<bool>(mFile.is_open()); }
+
+        // Bytes not read yet, an upper bound for counts the file claims to hold
+        uint64_t GetRemainingBytes() const { return mFileSize - mFileRead + (mEnd - mBegin); }
+
+        // Next line without its line break, false at the end of the file. The view is valid until the next read.
+        bool ReadLine(std::string_view& line) {
+            size_t searchFrom = mBegin;
+            while (true) {
+                const char* newline = static_cast<const char*>(std::memchr(mBuffer.data() + searchFrom, '\n', mEnd - searchFrom));
+                if (newline) {
+                    size_t end = static_cast<size_t>(newline - mBuffer.data());
+                    line = TrimLineBreak(std::string_view(mBuffer.data() + mBegin, end - mBegin));
+                    mBegin = end + 1;
+                    return true;
+                }
+
+                size_t scanned = mEnd - mBegin;
+                if (!Fill()) {
+                    if (mBegin == mEnd)
+                        return false;
+                    // Last line without a line break
+                    line = TrimLineBreak(std::string_view(mBuffer.data() + mBegin, mEnd - mBegin));
+                    mBegin = mEnd;
+                    return true;
+                }
+                searchFrom = mBegin + scanned;
+            }
+        }
+
+        bool ReadBytes(void* out, size_t size) {
+            while (mEnd - mBegin < size) {
+                if (!Fill())
+                    return false;
+            }
+            std::memcpy(out, mBuffer.data() + mBegin, size);
+            mBegin += size;
+            return true;
+        }
+
+    private:
+        static std::string_view TrimLineBreak(std::string_view line) {
+            if (!line.empty() && line.back() == '\r')
+                line.remove_suffix(1);
+            return line;
+        }
+
+        // Moves the unread bytes to the front and reads more behind them, false once the file has nothing left
+        bool Fill() {
+            if (mBegin > 0) {
+                std::memmove(mBuffer.data(), mBuffer.data() + mBegin, mEnd - mBegin);
+                mEnd -= mBegin;
+                mBegin = 0;
+            }
+            if (mEnd == mBuffer.size())
+                mBuffer.resize(mBuffer.size() * 2);
+
+            mFile.read(mBuffer.data() + mEnd, static_cast<std::streamsize>(mBuffer.size() - mEnd));
+            size_t count = static_cast<size_t>(mFile.gcount());
+            mEnd += count;
+            mFileRead += count;
+            return count > 0;
+        }
+
+    private:
+        std::ifstream mFile;
+        std::vector<char> mBuffer;
+        size_t mBegin = 0;
+        size_t mEnd = 0;
+        uint64_t mFileSize = 0;
+        uint64_t mFileRead = 0;
+    };
+
+    static void SkipSpaces(std::string_view& text) {
+        size_t count = 0;
+        while (count < text.size() && (text[count] == ' ' || text[count] == '\t'))
+            count++;
+        text.remove_prefix(count);
+    }
+
+    static std::string_view NextToken(std::string_view& text) {
+        SkipSpaces(text);
+        size_t length = 0;
+        while (length < text.size() && text[length] != ' ' && text[length] != '\t')
+            length++;
+        std::string_view token = text.substr(0, length);
+        text.remove_prefix(length);
+        return token;
+    }
+
+    template <typename T>
+    static bool ParseNumber(std::string_view& text, T& value) {
+        SkipSpaces(text);
+        // from_chars doesn't accept a leading '+'
+        if (!text.empty() && text[0] == '+')
+            text.remove_prefix(1);
+        std::from_chars_result result = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (result.ec != std::errc())
+            return false;
+        text.remove_prefix(static_cast<size_t>(result.ptr - text.data()));
+        return true;
+    }
+
+    static bool CheckIndices(const std::string& path, const Mesh& mesh) {
+        uint32_t vertexCount = mesh.GetVertexCount();
+        for (uint32_t index : mesh.indices) {
+            if (index >= vertexCount) {
+                std::cerr << path << ": face references vertex " << index << " but there are only " << vertexCount << "\n";
+                return false;
+            }
+        }
+        if (mesh.indices.empty()) {
+            std::cerr << path << ": no triangles\n";
+            return false;
+        }
+        return true;
+    }
+
+    // Splits a polygon into a fan around its first vertex
+    static void AddPolygon(Mesh& mesh, const std::vector<uint32_t>& polygon) {
+        for (size_t i = 2; i < polygon.size(); i++) {
+            mesh.indices.push_back(polygon[0]);
+            mesh.indices.push_back(polygon[i - 1]);
+            mesh.indices.push_back(polygon[i]);
+        }
+    }
+
+    bool LoadMeshOBJ(const std::string& path, Mesh& mesh) {
+        ChunkedReader reader(path);
+        if (!reader.IsOpen()) {
+            std::cerr << "Failed to open mesh " << path << "\n";
+            return false;
+        }
+
+        mesh = Mesh{};
+        mesh.source = path;
+
+        std::vector<uint32_t> polygon;
+        std::string_view line;
+        uint64_t lineNumber = 0;
+        while (reader.ReadLine(line)) {
+            lineNumber++;
+            std::string_view type = NextToken(line);
+
+            if (type == "v") {
+                glm::vec3 position;
+                if (!ParseNumber(line, position.x) || !ParseNumber(line, position.y) || !ParseNumber(line, position.z)) {
+                    std::cerr << path << ":" << lineNumber << ": malformed vertex\n";
+                    return false;
+                }
+                mesh.AddVertex(position);
+            } else if (type == "f") {
+                // Corners are v, v/vt, v/vt/vn or v//vn, only the position index matters
+                polygon.clear();
+                for (std::string_view corner = NextToken(line); !corner.empty(); corner = NextToken(line)) {
+                    int64_t index = 0;
+                    if (!ParseNumber(corner, index) || index == 0) {
+                        std::cerr << path << ":" << lineNumber << ": malformed face\n";
+                        return false;
+                    }
+                    // Negative indices count back from the last vertex read so far
+                    int64_t resolved = index > 0 ? index - 1 : static_cast<int64_t>(mesh.GetVertexCount()) + index;
+                    if (resolved < 0 || resolved > UINT32_MAX) {
+                        std::cerr << path << ":" << lineNumber << ": vertex index out of range\n";
+                        return false;
+                    }
+                    polygon.push_back(static_cast<uint32_t>(resolved));
+                }
+                if (polygon.size() < 3) {
+                    std::cerr << path << ":" << lineNumber << ": face with fewer than 3 vertices\n";
+                    return false;
+                }
+                AddPolygon(mesh, polygon);
+            }
+            // Normals, texture coordinates, groups and materials are ignored
+        }
+
+        return CheckIndices(path, mesh);
+    }
+
+    enum class PlyType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64, Invalid };
+
+    static PlyType ParsePlyType(std::string_view name) {
+        if (name == "char" || name == "int8") return PlyType::Int8;
+        if (name == "uchar" || name == "uint8") return PlyType::UInt8;
+        if (name == "short" || name == "int16") return PlyType::Int16;
+        if (name == "ushort" || name == "uint16") return PlyType::UInt16;
+        if (name == "int" || name == "int32") return PlyType::Int32;
+        if (name == "uint" || name == "uint32") return PlyType::UInt32;
+        if (name == "float" || name == "float32") return PlyType::Float32;
+        if (name == "double" || name == "float64") return PlyType::Float64;
+        return PlyType::Invalid;
+    }
+
+    static size_t PlyTypeSize(PlyType type) {
+        switch (type) {
+        case PlyType::Int8: case PlyType::UInt8: return 1;
+        case PlyType::Int16: case PlyType::UInt16: return 2;
+        case PlyType::Int32: case PlyType::UInt32: case PlyType::Float32: return 4;
+        case PlyType::Float64: return 8;
+        case PlyType::Invalid: break;
+        }
+        return 0;
+    }
+
+    struct PlyProperty {
+        std::string name;
+        PlyType type = PlyType::Invalid;
+        PlyType countType = PlyType::Invalid;   // Set for list properties
+        bool IsList() const { return countType != PlyType::Invalid; }
+    };
+
+    struct PlyElement {
+        std::string name;
+        uint64_t count = 0;
+        std::vector<PlyProperty> properties;
+    };
+
+    enum class PlyFormat { Ascii, BinaryLittleEndian, BinaryBigEndian };
+
+    // Longest list property accepted, far more vertices than any real polygon has
+    static constexpr double MaxPlyListSize = 65536.0;
+
+    template <typename T>
+    static double PlyValue(const uint8_t* bytes) {
+        T value;
+        std::memcpy(&value, bytes, sizeof(T));
+        return static_cast<double>(value);
+    }
+
+    // Reads one value of a binary file, every type fits a double exactly except the largest 64 bit integers PLY doesn't have
+    static bool ReadPlyBinary(ChunkedReader& reader, PlyType type, bool swapBytes, double& value) {
+        uint8_t bytes[8];
+        size_t size = PlyTypeSize(type);
+        if (!reader.ReadBytes(bytes, size))
+            return false;
+        if (swapBytes)
+            std::reverse(bytes, bytes + size);
+
+        switch (type) {
+        case PlyType::Int8: value = PlyValue<int8_t>(bytes); break;
+        case PlyType::UInt8: value = PlyValue<uint8_t>(bytes); break;
+        case PlyType::Int16: value = PlyValue<int16_t>(bytes); break;
+        case PlyType::UInt16: value = PlyValue<uint16_t>(bytes); break;
+        case PlyType::Int32: value = PlyValue<int32_t>(bytes); break;
+        case PlyType::UInt32: value = PlyValue<uint32_t>(bytes); break;
+        case PlyType::Float32: value = PlyValue<float>(bytes); break;
+        case PlyType::Float64: value = PlyValue<double>(bytes); break;
+        case PlyType::Invalid: return false;
+        }
+        return true;
+    }
+
+    static bool ReadPlyHeader(ChunkedReader& reader, const std::string& path, PlyFormat& format, std::vector<PlyElement>& elements) {
+        std::string_view line;
+        if (!reader.ReadLine(line) || line != "ply") {
+            std::cerr << path << ": not a PLY file\n";
+            return false;
+        }
+
+        bool hasFormat = false;
+        while (reader.ReadLine(line)) {
+            std::string_view keyword = NextToken(line);
+            if (keyword == "end_header") {
+                if (!hasFormat) {
+                    std::cerr << path << ": PLY header without a format\n";
+                    return false;
+                }
+                return true;
+            } else if (keyword == "format") {
+                std::string_view name = NextToken(line);
+                if (name == "ascii") {
+                    format = PlyFormat::Ascii;
+                } else if (name == "binary_little_endian") {
+                    format = PlyFormat::BinaryLittleEndian;
+                } else if (name == "binary_big_endian") {
+                    format = PlyFormat::BinaryBigEndian;
+                } else {
+                    std::cerr << path << ": unknown PLY format '" << name << "'\n";
+                    return false;
+                }
+                hasFormat = true;
+            } else if (keyword == "element") {
+                PlyElement element;
+                element.name = NextToken(line);
+                if (!ParseNumber(line, element.count)) {
+                    std::cerr << path << ": malformed PLY element '" << element.name << "'\n";
+                    return false;
+                }
+                elements.push_back(std::move(element));
+            } else if (keyword == "property") {
+                if (elements.empty()) {
+                    std::cerr << path << ": PLY property outside of an element\n";
+                    return false;
+                }
+                PlyProperty property;
+                std::string_view type = NextToken(line);
+                if (type == "list") {
+                    property.countType = ParsePlyType(NextToken(line));
+                    type = NextToken(line);
+                    if (property.countType == PlyType::Invalid || property.countType == PlyType::Float32 || property.countType == PlyType::Float64) {
+                        std::cerr << path << ": unsupported PLY list count type\n";
+                        return false;
+                    }
+                }
+                property.type = ParsePlyType(type);
+                property.name = NextToken(line);
+                if (property.type == PlyType::Invalid) {
+                    std::cerr << path << ": unknown PLY property type '" << type << "'\n";
+                    return false;
+                }
+                elements.back().properties.push_back(std::move(property));
+            }
+            // comment and obj_info lines carry nothing we need
+        }
+
+        std::cerr << path << ": PLY header without end_header\n";
+        return false;
+    }
+
+    bool LoadMeshPLY(const std::string& path, Mesh& mesh) {
+        ChunkedReader reader(path);
+        if (!reader.IsOpen()) {
+            std::cerr << "Failed to open mesh " << path << "\n";
+            return false;
+        }
+
+        PlyFormat format = PlyFormat::Ascii;
+        std::vector<PlyElement> elements;
+        if (!ReadPlyHeader(reader, path, format, elements))
+            return false;
+
+        mesh = Mesh{};
+        mesh.source = path;
+
+        const bool ascii = format == PlyFormat::Ascii;
+        const bool swapBytes = (format == PlyFormat::BinaryBigEndian) != (std::endian::native == std::endian::big);
+
+        std::string_view line;
+        std::vector<uint32_t> polygon;
+        std::vector<double> values;
+        for (const PlyElement& element : elements) {
+            const bool isVertex = element.name == "vertex";
+            const bool isFace = element.name == "face";
+            if (isVertex) {
+                // Every vertex takes at least a byte, so a corrupt count can't reserve more than the file could hold
+                size_t reserve = static_cast<size_t>(std::min(element.count, reader.GetRemainingBytes()));
+                mesh.x.reserve(reserve);
+                mesh.y.reserve(reserve);
+                mesh.z.reserve(reserve);
+            }
+
+            // Where each property ends up, -1 is skipped
+            std::vector<int> targets(element.properties.size(), -1);
+            for (size_t p = 0; p < element.properties.size(); p++) {
+                const PlyProperty& property = element.properties[p];
+                if (isVertex && !property.IsList() && property.name.size() == 1 && property.name[0] >= 'x' && property.name[0] <= 'z')
+                    targets[p] = property.name[0] - 'x';
+                else if (isFace && property.IsList() && (property.name == "vertex_indices" || property.name == "vertex_index"))
+                    targets[p] = 3;
+            }
+
+            for (uint64_t item = 0; item < element.count; item++) {
+                if (ascii && !reader.ReadLine(line)) {
+                    std::cerr << path << ": PLY file ends inside element '" << element.name << "'\n";
+                    return false;
+                }
+
+                glm::vec3 position(0.0f);
+                for (size_t p = 0; p < element.properties.size(); p++) {
+                    const PlyProperty& property = element.properties[p];
+                    auto read = [&](PlyType type, double& value) {
+                        return ascii ? ParseNumber(line, value) : ReadPlyBinary(reader, type, swapBytes, value);
+                    };
+
+                    // A list's values take at least a byte each, counts beyond what's left are corrupt
+                    double count = 1.0;
+                    double available = static_cast<double>(ascii ? line.size() : reader.GetRemainingBytes());
+                    if (property.IsList() && (!read(property.countType, count) || count < 0.0 || count > MaxPlyListSize || count > available)) {
+                        std::cerr << path << ": malformed PLY element '" << element.name << "'\n";
+                        return false;
+                    }
+                    values.resize(static_cast<size_t>(count));
+                    for (double& value : values) {
+                        if (!read(property.type, value)) {
+                            std::cerr << path << ": malformed or truncated PLY element '" << element.name << "'\n";
+                            return false;
+                        }
+                    }
+
+                    if (targets[p] == 3) {
+                        polygon.clear();
+                        for (double value : values) {
+                            if (value < 0.0 || value > UINT32_MAX) {
+                                std::cerr << path << ": vertex index out of range\n";
+                                return false;
+                            }
+                            polygon.push_back(static_cast<uint32_t>(value));
+                        }
+                        AddPolygon(mesh, polygon);
+                    } else if (targets[p] >= 0) {
+                        position[targets[p]] = static_cast<float>(values[0]);
+                    }
+                }
+                if (isVertex)
+                    mesh.AddVertex(position);
+            }
+        }
+
+        return CheckIndices(path, mesh);
+    }
+
+    bool LoadMesh(const std::string& path, Mesh& mesh) {
+        size_t dot = path.find_last_of('.');
+        std::string extension = dot == std::string::npos ? std::string() : path.substr(dot);
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+        if (extension == ".obj")
+            return LoadMeshOBJ(path, mesh);
+        if (extension == ".ply")
+            return LoadMeshPLY(path, mesh);
+        std::cerr << path << ": unknown mesh format, expected .obj or .ply\n";
+        return false;
+    }
+
+}
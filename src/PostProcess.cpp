@@ -0,0 +1,179 @@
+#include <PostProcess.h>
+#include <CpuFeatures.h>
+
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define RT_X86 1
+    #include <immintrin.h>
+    #if defined(_MSC_VER)
+        #define RT_TARGET_AVX2
+    #else
+        #define RT_TARGET_AVX2 __attribute__((target("avx2")))
+    #endif
+#endif
+
+namespace RT {
+
+    // Hable's curve without the white point normalization, the look the renderer always had
+    static constexpr float U2A = 0.15f;
+    static constexpr float U2B = 0.50f;
+    static constexpr float U2C = 0.10f;
+    static constexpr float U2D = 0.20f;
+    static constexpr float U2E = 0.02f;
+    static constexpr float U2F = 0.30f;
+
+    static float ToneMap(float x, ToneMapper toneMapper) {
+        switch (toneMapper) {
+        case ToneMapper::Uncharted2:
+            return ((x * (U2A * x + U2C * U2B) + U2D * U2E) / (x * (U2A * x + U2B) + U2D * U2F)) - U2E / U2F;
+        case ToneMapper::ACES:
+            return (x * (2.51f * x + 0.03f)) / (x * (2.43f * x + 0.59f) + 0.14f);
+        case ToneMapper::Reinhard:
+            return x / (1.0f + x);
+        }
+        return x;
+    }
+
+    glm::vec3 ApplyDisplayTransform(const glm::vec3& color, const DisplayTransform& transform) {
+        glm::vec3 result = color;
+        for (int c = 0; c < 3; c++) {
+            if (transform.toneMapping)
+                result[c] = ToneMap(result[c] * transform.exposure, transform.toneMapper);
+            if (transform.gammaCorrection && result[c] > 0.0f)
+                result[c] = std::pow(result[c], transform.invGamma);
+        }
+        return glm::clamp(result, glm::vec3(0), glm::vec3(1.0f));
+    }
+
+    void PostProcessScalar(const float* r, const float* g, const float* b, uint32_t count, const DisplayTransform& transform, uint8_t* rgba) {
+        for (uint32_t i = 0; i < count; i++) {
+            glm::vec3 color = ApplyDisplayTransform(glm::vec3(r[i], g[i], b[i]), transform);
+            rgba[4 * i + 0] = static_cast<uint8_t>(255.0f * color.r);
+            rgba[4 * i + 1] = static_cast<uint8_t>(255.0f * color.g);
+            rgba[4 * i + 2] = static_cast<uint8_t>(255.0f * color.b);
+            rgba[4 * i + 3] = 255;
+        }
+    }
+
+#ifdef RT_X86
+
+    RT_TARGET_AVX2 static __m256 ToneMapAVX2(__m256 x, ToneMapper toneMapper) {
+        const __m256 one = _mm256_set1_ps(1.0f);
+        switch (toneMapper) {
+        case ToneMapper::Uncharted2: {
+            __m256 ax = _mm256_mul_ps(_mm256_set1_ps(U2A), x);
+            __m256 numerator = _mm256_add_ps(_mm256_mul_ps(x, _mm256_add_ps(ax, _mm256_set1_ps(U2C * U2B))), _mm256_set1_ps(U2D * U2E));
+            __m256 denominator = _mm256_add_ps(_mm256_mul_ps(x, _mm256_add_ps(ax, _mm256_set1_ps(U2B))), _mm256_set1_ps(U2D * U2F));
+            return _mm256_sub_ps(_mm256_div_ps(numerator, denominator), _mm256_set1_ps(U2E / U2F));
+        }
+        case ToneMapper::ACES: {
+            __m256 numerator = _mm256_mul_ps(x, _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(2.51f), x), _mm256_set1_ps(0.03f)));
+            __m256 denominator = _mm256_add_ps(_mm256_mul_ps(x, _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(2.43f), x), _mm256_set1_ps(0.59f))), _mm256_set1_ps(0.14f));
+            return _mm256_div_ps(numerator, denominator);
+        }
+        case ToneMapper::Reinhard:
+            return _mm256_div_ps(x, _mm256_add_ps(one, x));
+        }
+        return x;
+    }
+
+    // log2 of positive normal floats: exponent plus the atanh series of the mantissa reduced to [0.75, 1.5), error around 2e-7
+    RT_TARGET_AVX2 static __m256 Log2AVX2(__m256 x) {
+        const __m256 one = _mm256_set1_ps(1.0f);
+        __m256i bits = _mm256_castps_si256(x);
+        __m256 exponent = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+        __m256 mantissa = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f800000)));
+
+        __m256 large = _mm256_cmp_ps(mantissa, _mm256_set1_ps(1.5f), _CMP_GE_OQ);
+        mantissa = _mm256_blendv_ps(mantissa, _mm256_mul_ps(mantissa, _mm256_set1_ps(0.5f)), large);
+        exponent = _mm256_add_ps(exponent, _mm256_and_ps(large, one));
+
+        __m256 t = _mm256_div_ps(_mm256_sub_ps(mantissa, one), _mm256_add_ps(mantissa, one));
+        __m256 t2 = _mm256_mul_ps(t, t);
+        __m256 series = _mm256_set1_ps(1.0f / 7.0f);
+        series = _mm256_add_ps(_mm256_mul_ps(series, t2), _mm256_set1_ps(1.0f / 5.0f));
+        series = _mm256_add_ps(_mm256_mul_ps(series, t2), _mm256_set1_ps(1.0f / 3.0f));
+        series = _mm256_add_ps(_mm256_mul_ps(series, t2), one);
+        return _mm256_add_ps(exponent, _mm256_mul_ps(_mm256_set1_ps(2.0f / 0.69314718f), _mm256_mul_ps(t, series)));
+    }
+
+    // 2^x from the integer part as exponent bits and a polynomial for the fraction, relative error around 1e-5
+    RT_TARGET_AVX2 static __m256 Exp2AVX2(__m256 x) {
+        x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-126.0f)), _mm256_set1_ps(126.0f));
+        __m256 whole = _mm256_floor_ps(x);
+        __m256 f = _mm256_sub_ps(x, whole);
+
+        __m256 p = _mm256_set1_ps(1.5403530e-4f);
+        p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(1.3333558e-3f));
+        p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(9.6181291e-3f));
+        p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(5.5504109e-2f));
+        p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(2.4022651e-1f));
+        p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(6.9314718e-1f));
+        p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(1.0f));
+
+        __m256i scale = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(whole), _mm256_set1_epi32(127)), 23);
+        return _mm256_mul_ps(p, _mm256_castsi256_ps(scale));
+    }
+
+    RT_TARGET_AVX2 static void PostProcessAVX2(const float* r, const float* g, const float* b, uint32_t count,
+                                               const DisplayTransform& transform, uint8_t* rgba) {
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 exposure = _mm256_set1_ps(transform.exposure);
+        const __m256 invGamma = _mm256_set1_ps(transform.invGamma);
+        const __m256 smallest = _mm256_set1_ps(1e-30f);
+        const float* channels[3] = { r, g, b };
+
+        uint32_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256i pixels = _mm256_set1_epi32(static_cast<int>(0xff000000u));
+            for (int c = 0; c < 3; c++) {
+                __m256 value = _mm256_loadu_ps(channels[c] + i);
+                if (transform.toneMapping)
+                    value = ToneMapAVX2(_mm256_mul_ps(value, exposure), transform.toneMapper);
+                // Clamping first gives the same result since pow keeps 0 and 1 in place, max also turns NaN into 0
+                value = _mm256_min_ps(_mm256_max_ps(value, zero), one);
+                if (transform.gammaCorrection) {
+                    __m256 positive = _mm256_cmp_ps(value, zero, _CMP_GT_OQ);
+                    __m256 corrected = Exp2AVX2(_mm256_mul_ps(invGamma, Log2AVX2(_mm256_max_ps(value, smallest))));
+                    value = _mm256_and_ps(_mm256_min_ps(corrected, one), positive);
+                }
+                __m256i quantized = _mm256_cvttps_epi32(_mm256_mul_ps(value, _mm256_set1_ps(255.0f)));
+                pixels = _mm256_or_si256(pixels, _mm256_slli_epi32(quantized, 8 * c));
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(rgba + 4 * i), pixels);
+        }
+        if (i < count)
+            PostProcessScalar(r + i, g + i, b + i, count - i, transform, rgba + 4 * i);
+    }
+
+#endif
+
+    struct PostProcessKernel {
+        PostProcessFn fn;
+        const char* name;
+    };
+
+    static PostProcessKernel SelectPostProcessKernel() {
+    #ifdef RT_X86
+        if (CpuSupportsAVX2())
+            return { PostProcessAVX2, "AVX2" };
+    #endif
+        return { PostProcessScalar, "Scalar" };
+    }
+
+    static const PostProcessKernel& GetKernel() {
+        static const PostProcessKernel kernel = SelectPostProcessKernel();
+        return kernel;
+    }
+
+    PostProcessFn GetPostProcessKernel() {
+        return GetKernel().fn;
+    }
+
+    const char* GetPostProcessKernelName() {
+        return GetKernel().name;
+    }
+
+}
@@ -0,0 +1,31 @@
+#include <RenderStats.h>
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+namespace RT {
+
+    bool WriteChromeTrace(const std::string& path, const std::vector<TraceEvent>& events) {
+        std::ofstream file(path);
+        if (!file) {
+            std::cerr << "Failed to create trace " << path << "\n";
+            return false;
+        }
+
+        // Microseconds with nanosecond digits, the default 6 significant digits would round a long capture to milliseconds
+        file << std::fixed << std::setprecision(3);
+        file << "{\"traceEvents\":[\n";
+        for (size_t i = 0; i < events.size(); i++) {
+            const TraceEvent& event = events[i];
+            file << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.threadIndex
+                 << ",\"ts\":" << event.start << ",\"dur\":" << event.duration
+                 << ",\"args\":{\"frame\":" << event.frame << ",\"x\":" << event.tileX << ",\"y\":" << event.tileY << "}}";
+            file << (i + 1 < events.size() ? ",\n" : "\n");
+        }
+        file << "],\"displayTimeUnit\":\"ms\"}\n";
+
+        return static_cast<bool>(file);
+    }
+
+}
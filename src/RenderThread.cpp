@@ -0,0 +1,121 @@
+#include <RenderThread.h>
+
+namespace RT {
+
+    RenderThread::RenderThread(const Core::Scene& scene, const Core::Camera& camera)
+        : mScene(scene), mCamera(camera), mRenderer(mScene), mImage(std::make_unique<Core::Image>(1, 1, 4)) {
+        mRenderer.OnResize(1, 1);
+        mThread = std::thread(&RenderThread::Run, this);
+    }
+
+    RenderThread::~RenderThread() {
+        {
+            std::lock_guard<std::mutex> lock(mCommandMutex);
+            mStopping = true;
+        }
+        mWake.notify_one();
+        mThread.join();
+    }
+
+    void RenderThread::Submit(Command command) {
+        {
+            std::lock_guard<std::mutex> lock(mCommandMutex);
+            mCommands.push_back(std::move(command));
+        }
+        mWake.notify_one();
+    }
+
+    void RenderThread::Resize(uint32_t width, uint32_t height) {
+        Submit([this, width, height](Context& ctx) {
+            if (width == mImage->width && height == mImage->height)
+                return;
+            mImage = std::make_unique<Core::Image>(width, height, 4);
+            ctx.camera.OnResize({static_cast<float>(width), static_cast<float>(height)});
+            ctx.renderer.OnResize(width, height);
+            ctx.restart = true;
+        });
+    }
+
+    const RenderedFrame* RenderThread::AcquireFrame() {
+        if (!(mMiddle.load(std::memory_order_acquire) & NewFrameBit))
+            return nullptr;
+        mFrontIndex = mMiddle.exchange(mFrontIndex, std::memory_order_acq_rel) & IndexMask;
+        return &mFrames[mFrontIndex];
+    }
+
+    void RenderThread::Run() {
+        std::vector<Command> commands;
+        while (true) {
+            {
+                // Once the image converged there is nothing to do until a command changes something
+                std::unique_lock<std::mutex> lock(mCommandMutex);
+                mWake.wait(lock, [this] { return mStopping || !mCommands.empty() || !mIdle; });
+                if (mStopping)
+                    return;
+                commands.swap(mCommands);
+            }
+
+            Context ctx{mScene, mCamera, mRenderer, mAccumulate, false};
+            // Any command may change what the image shows, without accumulation that takes one more pass over it
+            if (!commands.empty())
+                mPassTiles = 0;
+            for (Command& command : commands)
+                command(ctx);
+            commands.clear();
+            if (ctx.restart) {
+                mFrame = 1;
+                mRenderer.BeginPreview();
+            }
+
+            mRenderer.Render(mCamera, mImage.get(), mFrame);
+            mVersion++;
+            uint32_t tileCount = mRenderer.GetTileCount();
+            if (mTileVersions.size() != tileCount)
+                mTileVersions.assign(tileCount, mVersion);
+            for (uint32_t tile = 0; tile < tileCount; tile++) {
+                if (mRenderer.WasTileRendered(tile))
+                    mTileVersions[tile] = mVersion;
+            }
+            Publish();
+
+            // Previews don't add a sample, the frame count only moves on once the full resolution image does
+            bool previewed = mRenderer.IsPreviewing();
+            bool converged = mRenderer.IsConverged();
+            if (mAccumulate && !converged && !previewed)
+                mFrame++;
+            // Without accumulation every pass over the tiles repeats the last one, a frame budget may split a pass up
+            if (!previewed)
+                mPassTiles += mRenderer.GetStats().tilesRendered;
+            bool repeats = !mAccumulate && mPassTiles >= tileCount;
+            mIdle = (converged || repeats) && !previewed;
+        }
+    }
+
+    void RenderThread::Publish() {
+        RenderedFrame& frame = mFrames[mBackIndex];
+        uint32_t tileCount = mRenderer.GetTileCount();
+        if (!frame.image || frame.image->width != mImage->width || frame.image->height != mImage->height) {
+            frame.image = std::make_unique<Core::Image>(mImage->width, mImage->height, 4);
+            frame.tileVersions.assign(tileCount, 0);
+            frame.tiles.resize(tileCount);
+            for (uint32_t tile = 0; tile < tileCount; tile++)
+                frame.tiles[tile] = mRenderer.GetTileRegion(tile);
+        }
+        // The buffer was last filled a publish or two ago, only the tiles that changed since have to be copied
+        for (uint32_t tile = 0; tile < tileCount; tile++) {
+            if (frame.tileVersions[tile] != mTileVersions[tile])
+                Core::CopyRegion(*mImage, frame.image.get(), frame.tiles[tile]);
+        }
+        frame.tileVersions = mTileVersions;
+        frame.version = mVersion;
+        frame.stats = mRenderer.GetStats();
+        frame.frame = mRenderer.IsPreviewing() ? 0 : mFrame;
+        frame.convergence = mRenderer.GetConvergence();
+        frame.converged = mRenderer.IsConverged();
+        frame.previewing = mRenderer.IsPreviewing();
+        frame.threadCount = mRenderer.GetThreadCount();
+
+        mBackIndex = mMiddle.exchange(mBackIndex | NewFrameBit, std::memory_order_acq_rel) & IndexMask;
+    }
+
+}
@@ -1,192 +1,890 @@
 #include <Renderer.h>
+#include <BSDF.h>
 #include <algorithm>
-#include <execution>
+#include <cmath>
+#include <chrono>
+#include <cstring>
 
 #include <glm/common.hpp>
 
 namespace RT {
 
     Renderer::Renderer(const Core::Scene& scene)
-        : mScene(scene) {}
+        : mScene(scene), mIntersectSpheres(GetSphereIntersectKernel()), mPostProcess(GetPostProcessKernel()) {
+        BuildAccelerationStructure();
+    }
 
     void Renderer::Render(const Core::Camera& camera, Core::Image* image, uint32_t frame) {
-        if (frame == 1) {
-            for (int i = 0; i < image->width * image->height; i++) {
-                mAccumulatedData[i] = glm::vec3(0);
+        uint32_t pixelCount = image->width * image->height;
+        // Coarse preview frames don't touch the accumulation, it restarts once the preview reaches full resolution
+        uint32_t previewScale = mPreviewScale;
+        if (previewScale > 1)
+            mPreviewScale = previewScale / 2;
+        bool resetAccumulation = frame == 1 || (previewScale == 1 && mPreviewResetPending);
+        if (previewScale == 1)
+            mPreviewResetPending = false;
+
+        if (resetAccumulation) {
+            // The storage only changes with a fresh accumulation, so samples of different precisions never mix
+            if (mAccumulation.GetPrecision() != settings.accumulation)
+                mAccumulation.SetPrecision(settings.accumulation);
+            else
+                mAccumulation.Clear();
+            std::fill(mLuminanceSquares.begin(), mLuminanceSquares.end(), 0.0f);
+            std::fill(mSampleCounts.begin(), mSampleCounts.end(), 0);
+            std::fill(mPixelConverged.begin(), mPixelConverged.end(), 0);
+            std::fill(mHistoryUnverified.begin(), mHistoryUnverified.end(), 0);
+            mGBuffer.Clear();
+            mConvergedPixels = 0;
+            // Every scene edit restarts accumulation, so this catches lights and emissive materials that changed
+            mLightSampler.Build(mScene);
+            mSampler.SetType(settings.sampler);
+        }
+
+        using Clock = std::chrono::steady_clock;
+        Clock::time_point frameStart = Clock::now();
+        if (settings.captureTrace && !mTraceStarted) {
+            mTraceStart = frameStart;
+            mTraceStarted = true;
+        }
+        auto toMicroseconds = [this](Clock::time_point time) {
+            return std::chrono::duration<double, std::micro>(time - mTraceStart).count();
+        };
+
+        // A camera move alone keeps the samples, moved to where their surfaces are seen from the new view
+        bool reproject = !resetAccumulation && previewScale == 1 && settings.temporalReprojection && mHasHistory &&
+                         (camera.GetView() != mHistoryView || camera.GetProjection() != mHistoryProjection);
+        if (reproject)
+            Reproject(camera, image->width, image->height);
+        Clock::time_point reprojectEnd = Clock::now();
+        if (previewScale == 1) {
+            mHistoryView = camera.GetView();
+            mHistoryProjection = camera.GetProjection();
+            mHasHistory = true;
+        }
+
+        // Hand the samples converged pixels no longer take to the ones that are still noisy, so a frame costs
+        // roughly the same no matter how much of the image is done
+        uint32_t samplesPerPixel = 1;
+        if (settings.adaptiveSampling) {
+            uint32_t activePixels = pixelCount - mConvergedPixels;
+            if (activePixels > 0)
+                samplesPerPixel = std::clamp(pixelCount / activePixels, 1u, std::max(settings.maxSamplesPerFrame, 1u));
+        }
+
+        // With a frame time target the measured throughput decides how much work this frame gets: several samples
+        // per pixel when the whole image fits, otherwise one sample on as many tiles as fit, continuing where the
+        // last frame stopped
+        uint32_t tilesToRender = static_cast<uint32_t>(mTiles.size());
+        if (settings.targetFrameTimeMs > 0.0f && mSamplesPerMs > 0.0 && previewScale == 1) {
+            uint32_t activePixels = std::max(pixelCount - mConvergedPixels, 1u);
+            double budgetSamples = mSamplesPerMs * settings.targetFrameTimeMs;
+            if (budgetSamples >= activePixels) {
+                samplesPerPixel = std::clamp(static_cast<uint32_t>(budgetSamples / activePixels), 1u, MaxBudgetSamplesPerPixel);
+            } else {
+                samplesPerPixel = 1;
+                double fraction = budgetSamples / activePixels;
+                tilesToRender = std::clamp(static_cast<uint32_t>(std::ceil(fraction * mTiles.size())), 1u, tilesToRender);
             }
         }
+        if (mNextTile >= mTiles.size() || previewScale > 1)
+            mNextTile = 0;
+        uint32_t firstTile = mNextTile;
+        mNextTile = (firstTile + tilesToRender) % std::max<uint32_t>(static_cast<uint32_t>(mTiles.size()), 1u);
+        mRenderedFirstTile = firstTile;
+        mRenderedTileCount = tilesToRender;
+        mRenderedPreview = previewScale > 1;
+
+        uint32_t threadCount = mThreadPool.GetThreadCount();
+        if (mWavefrontQueues.size() < threadCount)
+            mWavefrontQueues.resize(threadCount);
+        mThreadStats.assign(threadCount, ThreadStats{});
+        if (mTraceEvents.size() < threadCount)
+            mTraceEvents.resize(threadCount);
+        if (settings.captureTrace)
+            TrimTrace();
 
-        std::for_each(std::execution::par_unseq, mVerticalIter.begin(), mVerticalIter.end(), [&, this](uint32_t y) {
-            std::for_each(std::execution::par_unseq, mHorizontalIter.begin(), mHorizontalIter.end(), [&, this, y](uint32_t x) {
-                const auto& rayDir = camera.GetRayDirections()[x + y * image->width];
-                Ray ray(camera.GetPosition(), rayDir);
-                uint32_t pixelIndex = x + y * image->width;
-                mRNG = pixelIndex + frame * 9941;
+        // The denoiser needs every pixel at once and reprojection moved all of them, so tiles skip their resolve and
+        // the whole image is resolved at the end
+        bool resolveImage = (settings.denoise || reproject) && previewScale == 1 && settings.resolveEveryFrame;
+        if (!settings.denoise)
+            mDenoised = false;
 
-                glm::vec3 color = TraceRay(ray);
-                mAccumulatedData[pixelIndex] += color;
-                glm::vec3 accumColor = mAccumulatedData[pixelIndex];
-                accumColor /= (float)frame;
+        DisplayTransform transform = GetDisplayTransform();
+        mThreadPool.ParallelFor(tilesToRender, [&, this](uint32_t task, uint32_t threadIdx) {
+            Clock::time_point tileStart = Clock::now();
+            const Tile& tile = mTiles[(firstTile + task) % mTiles.size()];
+            uint32_t tileConverged = 0;
+            if (previewScale > 1) {
+                PreviewTile(camera, tile, image, previewScale, transform);
+            } else if (settings.integrator == Integrator::Wavefront) {
+                TraceTileWavefront(camera, tile, image->width, samplesPerPixel, mWavefrontQueues[threadIdx]);
+            } else {
+                TraceTile(camera, tile, image->width, samplesPerPixel);
+            }
 
-                // Post-Processing
-                if (doToneMapping)
-                    accumColor = ApplyToneMapping(accumColor * exposure);
-                if (doGammaCorrection)
-                    accumColor = ApplyGammaCorrection(accumColor);
-                accumColor = glm::clamp(accumColor, glm::vec3(0), glm::vec3(1.0f));
+            for (uint32_t y = tile.y0; y < tile.y1 && previewScale == 1 && settings.adaptiveSampling; y++) {
+                for (uint32_t x = tile.x0; x < tile.x1; x++) {
+                    uint32_t pixelIndex = x + y * image->width;
+                    if (!mPixelConverged[pixelIndex] && mSampleCounts[pixelIndex] >= settings.minAdaptiveSamples &&
+                        RelativeError(pixelIndex) < settings.noiseThreshold) {
+                        mPixelConverged[pixelIndex] = 1;
+                        tileConverged++;
+                    }
+                }
+            }
+            if (previewScale == 1 && settings.resolveEveryFrame && !resolveImage)
+                ResolveTile(tile, image, transform);
+            mConvergedPixels += tileConverged;
 
-                int pixelIdx = image->comps * (y * image->width + x);
-                DrawPixel(image, pixelIdx, {accumColor, 1});
-            });
+            // Only this thread writes its slot, the counters are summed once the frame is done
+            Clock::time_point tileEnd = Clock::now();
+            double tileTime = std::chrono::duration<double, std::milli>(tileEnd - tileStart).count();
+            ThreadStats& stats = mThreadStats[threadIdx];
+            stats.counters.primaryRays += mCounters.primaryRays;
+            stats.counters.secondaryRays += mCounters.secondaryRays;
+            stats.counters.shadowRays += mCounters.shadowRays;
+            stats.counters.intersectionTests += mCounters.intersectionTests;
+            stats.counters.bvhNodeVisits += mCounters.bvhNodeVisits;
+            stats.counters.samples += mCounters.samples;
+            stats.busyMs += tileTime;
+            stats.minTileMs = std::min(stats.minTileMs, tileTime);
+            stats.maxTileMs = std::max(stats.maxTileMs, tileTime);
+            stats.tiles++;
+            mCounters = RayCounters{};
+
+            if (settings.captureTrace) {
+                mTraceEvents[threadIdx].push_back({"Tile", threadIdx, toMicroseconds(tileStart), tileTime * 1000.0,
+                                                   frame, tile.x0 / TileSize, tile.y0 / TileSize});
+            }
         });
+
+        Clock::time_point tracingEnd = Clock::now();
+        if (resolveImage) {
+            Resolve(image);
+            mRenderedFirstTile = 0;
+            mRenderedTileCount = static_cast<uint32_t>(mTiles.size());
+        }
+
+        Clock::time_point frameEnd = Clock::now();
+        RenderStats stats;
+        stats.frameTimeMs = std::chrono::duration<double, std::milli>(frameEnd - frameStart).count();
+        stats.resolveTimeMs = resolveImage ? std::chrono::duration<double, std::milli>(frameEnd - tracingEnd).count() : 0.0;
+        stats.reprojectTimeMs = reproject ? std::chrono::duration<double, std::milli>(reprojectEnd - frameStart).count() : 0.0;
+        stats.reprojectedPixels = reproject ? mReprojectedPixels : 0;
+        stats.minTileTimeMs = mThreadStats.empty() ? 0.0 : mThreadStats[0].minTileMs;
+        uint32_t tileCount = 0;
+        for (const ThreadStats& thread : mThreadStats) {
+            stats.primaryRays += thread.counters.primaryRays;
+            stats.secondaryRays += thread.counters.secondaryRays;
+            stats.shadowRays += thread.counters.shadowRays;
+            stats.intersectionTests += thread.counters.intersectionTests;
+            stats.bvhNodeVisits += thread.counters.bvhNodeVisits;
+            stats.samples += thread.counters.samples;
+            stats.minTileTimeMs = std::min(stats.minTileTimeMs, thread.minTileMs);
+            stats.maxTileTimeMs = std::max(stats.maxTileTimeMs, thread.maxTileMs);
+            stats.avgTileTimeMs += thread.busyMs;
+            stats.threadBusyMs.push_back(thread.busyMs);
+            stats.threadIdleMs.push_back(std::max(stats.frameTimeMs - thread.busyMs, 0.0));
+            tileCount += thread.tiles;
+        }
+        stats.avgTileTimeMs = tileCount > 0 ? stats.avgTileTimeMs / tileCount : 0.0;
+        if (tileCount == 0)
+            stats.minTileTimeMs = 0.0;
+        stats.samplesPerPixel = previewScale > 1 ? 0 : samplesPerPixel;
+        stats.tilesRendered = tilesToRender;
+
+        // Smoothed so a single slow frame doesn't make the budget swing back and forth
+        if (previewScale == 1 && stats.samples > 0 && stats.frameTimeMs > 0.0) {
+            double samplesPerMs = stats.samples / stats.frameTimeMs;
+            mSamplesPerMs = mSamplesPerMs > 0.0 ? 0.7 * mSamplesPerMs + 0.3 * samplesPerMs : samplesPerMs;
+        }
+        mRaysTraced += stats.GetRaysTraced();
+        mStats = std::move(stats);
+
+        if (settings.captureTrace)
+            mTraceEvents[0].push_back({"Frame", 0, toMicroseconds(frameStart), mStats.frameTimeMs * 1000.0, frame, 0, 0});
     }
 
-    void Renderer::OnResize(uint32_t width, uint32_t height) {
-        delete mAccumulatedData;
-        mAccumulatedData = new glm::vec3[width * height];
-        mVerticalIter.resize(height);
-        mHorizontalIter.resize(width);
+    void Renderer::BeginPreview() {
+        if (!settings.interactivePreview)
+            return;
+        mPreviewScale = PreviewStartScale;
+        mPreviewResetPending = true;
+    }
+
+    /*
+     *  Traces one path per block of scale x scale pixels and fills the whole block with it. Blocks are aligned to the
+     *  tile, TileSize is a multiple of every preview scale, so each tile is still written by exactly one thread.
+    */
+    void Renderer::PreviewTile(const Core::Camera& camera, const Tile& tile, Core::Image* image, uint32_t scale, const DisplayTransform& transform) {
+        for (uint32_t by = tile.y0; by < tile.y1; by += scale) {
+            for (uint32_t bx = tile.x0; bx < tile.x1; bx += scale) {
+                uint32_t bx1 = std::min(bx + scale, tile.x1);
+                uint32_t by1 = std::min(by + scale, tile.y1);
+                float centerX = 0.5f * static_cast<float>(bx + bx1);
+                float centerY = 0.5f * static_cast<float>(by + by1);
 
-        for (int i = 0; i < width * height; i++)
-            mAccumulatedData[i] = glm::vec3(0);
-        for (int i = 0; i < height; i++)
-            mVerticalIter[i] = i;
-        for (int i = 0; i < width; i++)
-            mHorizontalIter[i] = i;
+                SamplerState sampler = mSampler.Start(bx, by, image->width, 0);
+                Ray ray(camera.GetPosition(), camera.GetRayGeneration() == Core::Camera::RayGeneration::Analytic
+                    ? camera.GetRayDirection(centerX, centerY)
+                    : camera.GetRayDirections()[static_cast<uint32_t>(centerX) + static_cast<uint32_t>(centerY) * image->width]);
+                FirstHit firstHit;
+                glm::vec4 color(ApplyDisplayTransform(TraceRay(ray, sampler, firstHit), transform), 1);
+
+                for (uint32_t y = by; y < by1; y++) {
+                    for (uint32_t x = bx; x < bx1; x++)
+                        DrawPixel(image, image->comps * (y * image->width + x), color);
+                }
+            }
+        }
     }
 
-    glm::vec3 Renderer::TraceRay(const Ray& pixelRay) {
-        glm::vec3 contribution{1};
-        glm::vec3 incomingLight{0};
-        Ray ray = pixelRay;
+    void Renderer::Resolve(Core::Image* image) {
+        mDenoised = settings.denoise && !mSampleCounts.empty();
+        if (mDenoised)
+            DenoiseImage(image->width, image->height);
 
-        for (int i = 0; i < bounceLimit; i++) {
-            HitInfo hitInfo = RayIntersectionTest(ray);
-            if (hitInfo.objIdx < 0) {
-                incomingLight += mScene.skyLight.color * mScene.skyLight.strength * contribution;
-                break;
+        DisplayTransform transform = GetDisplayTransform();
+        mThreadPool.ParallelFor(static_cast<uint32_t>(mTiles.size()), [&, this](uint32_t task, uint32_t) {
+            ResolveTile(mTiles[task], image, transform);
+        });
+    }
+
+    // Noise is passed as the variance of the pixel's mean luminance once there are enough samples to estimate it
+    void Renderer::DenoiseImage(uint32_t width, uint32_t height) {
+        mDenoiser.Resize(width, height);
+        mThreadPool.ParallelFor(static_cast<uint32_t>(mTiles.size()), [&, this](uint32_t task, uint32_t) {
+            const Tile& tile = mTiles[task];
+            for (uint32_t y = tile.y0; y < tile.y1; y++) {
+                for (uint32_t x = tile.x0; x < tile.x1; x++) {
+                    uint32_t pixelIndex = x + y * width;
+                    uint32_t sampleCount = mSampleCounts[pixelIndex];
+                    glm::vec3 mean = mAccumulation.GetMean(pixelIndex, std::max(sampleCount, 1u));
+                    float variance = -1.0f;
+                    if (sampleCount >= MinDenoiserVarianceSamples) {
+                        float n = static_cast<float>(sampleCount);
+                        float meanLuminance = glm::dot(mean, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+                        variance = std::max(mLuminanceSquares[pixelIndex] / n - meanLuminance * meanLuminance, 0.0f) / (n - 1.0f);
+                    }
+                    glm::vec3 albedo(mGBuffer.albedoR[pixelIndex], mGBuffer.albedoG[pixelIndex], mGBuffer.albedoB[pixelIndex]);
+                    mDenoiser.SetPixel(pixelIndex, mean, variance, albedo);
+                }
+            }
+        });
+        mDenoiser.Denoise(mGBuffer, settings.denoiser, mThreadPool);
+    }
+
+    /*
+     *  Gathers a row of pixel means into separate channel arrays so the post-process kernel can work on 8 pixels at a
+     *  time. Images without an alpha channel don't match the kernel's RGBA8 output and go through DrawPixel instead.
+    */
+    void Renderer::ResolveTile(const Tile& tile, Core::Image* image, const DisplayTransform& transform) {
+        alignas(32) float rowR[TileSize], rowG[TileSize], rowB[TileSize];
+        uint32_t count = tile.x1 - tile.x0;
+        for (uint32_t y = tile.y0; y < tile.y1; y++) {
+            uint32_t rowStart = tile.x0 + y * image->width;
+            // The denoiser's output is already stored by channel and is read in place
+            const float* r = rowR;
+            const float* g = rowG;
+            const float* b = rowB;
+            if (mDenoised) {
+                r = mDenoiser.GetChannel(0) + rowStart;
+                g = mDenoiser.GetChannel(1) + rowStart;
+                b = mDenoiser.GetChannel(2) + rowStart;
+            } else {
+                for (uint32_t i = 0; i < count; i++) {
+                    uint32_t pixelIndex = rowStart + i;
+                    glm::vec3 mean = mAccumulation.GetMean(pixelIndex, std::max(mSampleCounts[pixelIndex], 1u));
+                    rowR[i] = mean.r;
+                    rowG[i] = mean.g;
+                    rowB[i] = mean.b;
+                }
+            }
+
+            if (image->comps == 4) {
+                mPostProcess(r, g, b, count, transform, image->pixels.data() + static_cast<size_t>(rowStart) * 4);
+            } else {
+                for (uint32_t i = 0; i < count; i++)
+                    DrawPixel(image, image->comps * (rowStart + i), ApplyDisplayTransform(glm::vec3(r[i], g[i], b[i]), transform));
             }
+        }
+    }
 
-            const glm::vec3& hitNorm = hitInfo.surfaceNormal;
-            const Core::Sphere& closestSphere = mScene.spheres[hitInfo.objIdx];
-            const Core::Material& mat = mScene.materials[closestSphere.materialIndex];
+    DisplayTransform Renderer::GetDisplayTransform() const {
+        DisplayTransform transform;
+        transform.toneMapping = settings.doToneMapping;
+        transform.toneMapper = settings.toneMapper;
+        transform.exposure = settings.exposure;
+        transform.gammaCorrection = settings.doGammaCorrection;
+        transform.invGamma = 1 / settings.gamma;
+        return transform;
+    }
+
+    Core::ImageRegion Renderer::GetTileRegion(uint32_t tile) const {
+        const Tile& t = mTiles[tile];
+        return {t.x0, t.y0, t.x1 - t.x0, t.y1 - t.y0};
+    }
+
+    bool Renderer::WasTileRendered(uint32_t tile) const {
+        uint32_t tileCount = static_cast<uint32_t>(mTiles.size());
+        return (tile + tileCount - mRenderedFirstTile) % tileCount < mRenderedTileCount;
+    }
 
-            ray.org = hitInfo.worldPosition;
-            glm::vec3 diffDir = glm::normalize(hitNorm + RandomDirection(mRNG));
-            glm::vec3 specDir = ray.dir - 2.0f * hitNorm * glm::dot(ray.dir, hitNorm);
+    void Renderer::ClearTrace() {
+        mTraceEvents.clear();
+        mTraceStarted = false;
+    }
 
-            ray.org += hitNorm * 0.0001f;
-            ray.dir = glm::mix(diffDir, specDir, mat.shininess);
+    void Renderer::TrimTrace() {
+        size_t eventCount = 0;
+        for (const std::vector<TraceEvent>& threadEvents : mTraceEvents)
+            eventCount += threadEvents.size();
+        if (eventCount < MaxTraceEvents)
+            return;
 
-            glm::vec3 emittedLight = mat.emissionColor * mat.emissionStrength;
-            incomingLight += emittedLight * contribution;
-            contribution *= mat.albedo;
+        // Cut at the start of the middle frame, so the capture still begins with a whole frame
+        std::vector<double> frameStarts;
+        for (const TraceEvent& event : mTraceEvents[0]) {
+            if (std::strcmp(event.name, "Frame") == 0)
+                frameStarts.push_back(event.start);
+        }
+        if (frameStarts.empty())
+            return;
+        std::nth_element(frameStarts.begin(), frameStarts.begin() + frameStarts.size() / 2, frameStarts.end());
+        double cutoff = frameStarts[frameStarts.size() / 2];
+        for (std::vector<TraceEvent>& threadEvents : mTraceEvents) {
+            threadEvents.erase(std::remove_if(threadEvents.begin(), threadEvents.end(),
+                                              [cutoff](const TraceEvent& event) { return event.start < cutoff; }),
+                               threadEvents.end());
         }
+    }
 
-        return incomingLight;
+    bool Renderer::SaveTrace(const std::string& path) const {
+        std::vector<TraceEvent> events;
+        for (const std::vector<TraceEvent>& threadEvents : mTraceEvents)
+            events.insert(events.end(), threadEvents.begin(), threadEvents.end());
+        std::sort(events.begin(), events.end(), [](const TraceEvent& a, const TraceEvent& b) { return a.start < b.start; });
+        return WriteChromeTrace(path, events);
+    }
+
+    uint64_t Renderer::GetSamplesTaken() const {
+        uint64_t samples = 0;
+        for (uint32_t count : mSampleCounts)
+            samples += count;
+        return samples;
+    }
+
+    float Renderer::GetConvergence() const {
+        if (mSampleCounts.empty())
+            return 0.0f;
+        return static_cast<float>(mConvergedPixels) / static_cast<float>(mSampleCounts.size());
+    }
+
+    bool Renderer::IsConverged() const {
+        return settings.adaptiveSampling && !mSampleCounts.empty() && GetConvergence() >= settings.convergenceTarget;
     }
 
     /*
-     *  (Cx - x)^2 + (Cy - y)^2 + (Cz - z)^2 = r^2, where C is the Circle position and r is the radius
-     *  From This equation, x, y, z, are the components of the ray, which results in the following
-     *  (Cx - (Ox + tDx))^2 + (Cy - (Oy + tDy))^2 + (Cz - (Oz + tDz))^2 = r^2 where O is the origin ray, D is the direction and t is scalar to solve for
-     *  For simplicity we can assume the circle is at the origin of the world, so the result is the following
-     *  (Ox + tDx) ^ 2 + (Oy + tDy) ^ 2 + (Oz + tDz)^2 = r^2
-     *  Ox^2 + 2OxtDx + t^2Dx^2 + Oy^2 + 2OytDy + t^2Dy^2 + Oz^2 + 2OztDz + t^2Dz^2 = r^2
-     *  t^2(Dx^2 + Dy^2 + Dz^2) + 2t(OxDx + OyDy + OzDz) + (Ox^2 + Oy^2 + Oz^2) = r^2
-     *
-     *  t^2 (D.D) + 2t(O.D) + (O.O) - r^2 = 0
-     *  Solve for t using quadratic formula
+     *  The previous view's pixels are set aside and every pixel of the new view takes over the samples of the one
+     *  Reprojection found for it, counted as at most settings.reprojectionMaxSamples samples. Moving surfaces between
+     *  pixels resamples them a little, so the history isn't trusted as much as the samples it was made of, and new
+     *  samples soon take over. Converged pixels are looked at again, their neighbourhood changed.
     */
-    Renderer::HitInfo Renderer::RayIntersectionTest(const Ray& ray) {
-        // TODO: Make it support multiple kinds of objects other than spheres
-        const Core::Sphere* closestSphere = nullptr;
-        float tmin = FLT_MAX;
-        int objIdx = -1;
-        for (int i = 0; i < mScene.spheres.size(); i++) {
-            const auto& sphere = mScene.spheres[i];
-            glm::vec3 origin = ray.org - sphere.position; // if the camera is moved somewhere offset the rendering as if the circle is at the origin of the camera
-            float a = glm::dot(ray.dir, ray.dir);
-            float b = 2.0f * glm::dot(origin, ray.dir);
-            float c = glm::dot(origin, origin) - sphere.radius*sphere.radius;
-            float discriminant = b*b - 4*a*c;
+    void Renderer::Reproject(const Core::Camera& camera, uint32_t width, uint32_t height) {
+        uint32_t pixelCount = width * height;
+        mReprojection.Build(mHistoryView, mHistoryProjection, camera, mGBuffer, mSampleCounts, width, height, mThreadPool);
 
-            // (-b +- sqrt(b^2 - 4ac))/2a
-            if (discriminant < 0) {
-                continue;
+        mHistoryMeans.resize(pixelCount);
+        mThreadPool.ParallelFor(static_cast<uint32_t>(mTiles.size()), [&, this](uint32_t task, uint32_t) {
+            const Tile& tile = mTiles[task];
+            for (uint32_t y = tile.y0; y < tile.y1; y++) {
+                for (uint32_t x = tile.x0; x < tile.x1; x++) {
+                    uint32_t pixelIndex = x + y * width;
+                    mHistoryMeans[pixelIndex] = mAccumulation.GetMean(pixelIndex, std::max(mSampleCounts[pixelIndex], 1u));
+                }
             }
+        });
+        std::swap(mSampleCounts, mHistorySampleCounts);
+        std::swap(mLuminanceSquares, mHistoryLuminanceSquares);
+        std::swap(mGBuffer, mHistoryGBuffer);
+        mSampleCounts.resize(pixelCount);
+        mLuminanceSquares.resize(pixelCount);
+        if (mGBuffer.depth.size() != pixelCount)
+            mGBuffer.Resize(pixelCount);
+
+        std::atomic<uint32_t> reprojected = 0;
+        mThreadPool.ParallelFor(static_cast<uint32_t>(mTiles.size()), [&, this](uint32_t task, uint32_t) {
+            const Tile& tile = mTiles[task];
+            uint32_t tileReprojected = 0;
+            for (uint32_t y = tile.y0; y < tile.y1; y++) {
+                for (uint32_t x = tile.x0; x < tile.x1; x++) {
+                    uint32_t pixelIndex = x + y * width;
+                    int32_t source = mReprojection.GetSource(pixelIndex);
+                    mPixelConverged[pixelIndex] = 0;
+                    if (source == Reprojection::NoSource) {
+                        mAccumulation.SetMean(pixelIndex, glm::vec3(0.0f), 0);
+                        mSampleCounts[pixelIndex] = 0;
+                        mLuminanceSquares[pixelIndex] = 0.0f;
+                        mGBuffer.AddSample(pixelIndex, FirstHit{}, 1);
+                        mHistoryUnverified[pixelIndex] = 0;
+                        continue;
+                    }
 
-            float t0 = (-b - glm::sqrt(discriminant)) / (2.0f * a);
-            //float t1 = (-b + glm::sqrt(discriminant)) / (2.0f * a);
-            if (t0 < tmin && t0 >= 0) {
-                closestSphere = &sphere;
-                tmin = t0;
-                objIdx = i;
+                    uint32_t sourceIndex = static_cast<uint32_t>(source);
+                    uint32_t historyCount = mHistorySampleCounts[sourceIndex];
+                    uint32_t sampleCount = std::min(historyCount, std::max(settings.reprojectionMaxSamples, 1u));
+                    mAccumulation.SetMean(pixelIndex, mHistoryMeans[sourceIndex], sampleCount);
+                    mSampleCounts[pixelIndex] = sampleCount;
+                    mLuminanceSquares[pixelIndex] = mHistoryLuminanceSquares[sourceIndex] * static_cast<float>(sampleCount) / static_cast<float>(historyCount);
+                    FirstHit history;
+                    history.albedo = glm::vec3(mHistoryGBuffer.albedoR[sourceIndex], mHistoryGBuffer.albedoG[sourceIndex], mHistoryGBuffer.albedoB[sourceIndex]);
+                    history.normal = glm::vec3(mHistoryGBuffer.normalX[sourceIndex], mHistoryGBuffer.normalY[sourceIndex], mHistoryGBuffer.normalZ[sourceIndex]);
+                    history.depth = mReprojection.GetDepth(pixelIndex);
+                    mGBuffer.AddSample(pixelIndex, history, 1);
+                    mHistoryUnverified[pixelIndex] = 1;
+                    tileReprojected++;
+                }
             }
+            reprojected += tileReprojected;
+        });
+        mConvergedPixels = 0;
+        mReprojectedPixels = reprojected;
+    }
+
+    // Misses only match misses. A history whose first hits were scattered, seen through glass or across an edge,
+    // has a short mean normal and can't be told apart from one new sample, so it is kept.
+    void Renderer::VerifyHistory(uint32_t pixelIndex, const FirstHit& firstHit) {
+        mHistoryUnverified[pixelIndex] = 0;
+        float depth = mGBuffer.depth[pixelIndex];
+        glm::vec3 normal(mGBuffer.normalX[pixelIndex], mGBuffer.normalY[pixelIndex], mGBuffer.normalZ[pixelIndex]);
+        float coherence = glm::length(normal);
+        bool sameSurface = true;
+        if (depth <= 0.0f && coherence == 0.0f) {
+            sameSurface = firstHit.depth <= 0.0f;
+        } else if (coherence >= MinHistoryCoherence) {
+            sameSurface = firstHit.depth > 0.0f &&
+                          std::abs(depth - firstHit.depth) <= settings.reprojectionDepthTolerance * firstHit.depth &&
+                          glm::dot(normal, firstHit.normal) >= 0.8f * coherence;
         }
+        if (sameSurface)
+            return;
+        mAccumulation.SetMean(pixelIndex, glm::vec3(0.0f), 0);
+        mSampleCounts[pixelIndex] = 0;
+        mLuminanceSquares[pixelIndex] = 0.0f;
+    }
 
-        HitInfo hitInfo{};
-        if (!closestSphere) {
-            return hitInfo;
+    void Renderer::AddSample(uint32_t pixelIndex, const glm::vec3& color, const FirstHit& firstHit) {
+        float luminance = glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+        if (mHistoryUnverified[pixelIndex])
+            VerifyHistory(pixelIndex, firstHit);
+        uint32_t sampleCount = ++mSampleCounts[pixelIndex];
+        mAccumulation.AddSample(pixelIndex, color, sampleCount);
+        mGBuffer.AddSample(pixelIndex, firstHit, sampleCount);
+        mCounters.samples++;
+        mLuminanceSquares[pixelIndex] += luminance * luminance;
+    }
+
+    // Standard error of the pixel's mean luminance relative to the mean, from the running sum and sum of squares
+    float Renderer::RelativeError(uint32_t pixelIndex) const {
+        float n = static_cast<float>(mSampleCounts[pixelIndex]);
+        float mean = glm::dot(mAccumulation.GetMean(pixelIndex, mSampleCounts[pixelIndex]), glm::vec3(0.2126f, 0.7152f, 0.0722f));
+        float variance = std::max(mLuminanceSquares[pixelIndex] / n - mean * mean, 0.0f) * n / (n - 1.0f);
+        return std::sqrt(variance / n) / std::max(mean, 1e-3f);
+    }
+
+    // Analytic cameras build the direction from the camera basis, jittered inside the pixel so accumulating samples anti-aliases edges
+    glm::vec3 Renderer::PrimaryRayDirection(const Core::Camera& camera, uint32_t x, uint32_t y, uint32_t width, SamplerState& sampler) {
+        if (camera.GetRayGeneration() == Core::Camera::RayGeneration::Cached)
+            return camera.GetRayDirections()[x + y * width];
+
+        glm::vec2 offset(0.0f);
+        if (settings.jitterPrimaryRays)
+            offset = mSampler.Get2D(sampler, SampleDimension::Pixel);
+        return camera.GetRayDirection(static_cast<float>(x) + offset.x, static_cast<float>(y) + offset.y);
+    }
+
+    void Renderer::TraceTile(const Core::Camera& camera, const Tile& tile, uint32_t width, uint32_t samplesPerPixel) {
+        for (uint32_t y = tile.y0; y < tile.y1; y++) {
+            for (uint32_t x = tile.x0; x < tile.x1; x++) {
+                uint32_t pixelIndex = x + y * width;
+                if (mPixelConverged[pixelIndex])
+                    continue;
+
+                for (uint32_t s = 0; s < samplesPerPixel; s++) {
+                    SamplerState sampler = mSampler.Start(x, y, width, mSampleCounts[pixelIndex]);
+                    Ray ray(camera.GetPosition(), PrimaryRayDirection(camera, x, y, width, sampler));
+                    FirstHit firstHit;
+                    glm::vec3 color = TraceRay(ray, sampler, firstHit);
+                    AddSample(pixelIndex, color, firstHit);
+                }
+            }
         }
+    }
 
-        hitInfo.worldPosition = ray.org + tmin * ray.dir;
-        hitInfo.surfaceNormal = glm::normalize(hitInfo.worldPosition - closestSphere->position);
-        hitInfo.hitDistance = tmin;
-        hitInfo.objIdx = objIdx;
-        return hitInfo;
+    /*
+     *  Traces every path of a tile one bounce at a time instead of one path at a time. Each stage runs over the whole
+     *  queue before the next one starts and finished paths are compacted away between bounces, so the live paths stay
+     *  dense and every stage runs the same code over contiguous memory. Paths keep their own sampler state and go through
+     *  the same ScatterRay as TraceRay, so both integrators produce the same image.
+    */
+    void Renderer::TraceTileWavefront(const Core::Camera& camera, const Tile& tile, uint32_t width, uint32_t samplesPerPixel, WavefrontQueue& queue) {
+        uint32_t tileWidth = tile.x1 - tile.x0;
+        queue.Resize(tileWidth * (tile.y1 - tile.y0) * samplesPerPixel);
+
+        // Generate: one camera ray per sample of every pixel that still needs samples
+        const glm::vec3& camPos = camera.GetPosition();
+        uint32_t pathCount = 0;
+        for (uint32_t y = tile.y0; y < tile.y1; y++) {
+            for (uint32_t x = tile.x0; x < tile.x1; x++) {
+                uint32_t pixelIndex = x + y * width;
+                if (mPixelConverged[pixelIndex])
+                    continue;
+
+                for (uint32_t s = 0; s < samplesPerPixel; s++) {
+                    uint32_t i = pathCount++;
+                    queue.sampler[i] = mSampler.Start(x, y, width, mSampleCounts[pixelIndex] + s);
+                    glm::vec3 rayDir = PrimaryRayDirection(camera, x, y, width, queue.sampler[i]);
+                    queue.orgX[i] = camPos.x; queue.orgY[i] = camPos.y; queue.orgZ[i] = camPos.z;
+                    queue.dirX[i] = rayDir.x; queue.dirY[i] = rayDir.y; queue.dirZ[i] = rayDir.z;
+                    queue.throughputR[i] = 1.0f; queue.throughputG[i] = 1.0f; queue.throughputB[i] = 1.0f;
+                    queue.pathIndex[i] = i;
+                    queue.pixel[i] = pixelIndex;
+                    queue.radiance[i] = glm::vec3(0);
+                    queue.firstHit[i] = FirstHit{};
+                    queue.bsdfPdf[i] = 0.0f;
+                }
+            }
+        }
+
+        uint32_t activeCount = pathCount;
+        for (int bounce = 0; bounce < settings.bounceLimit && activeCount > 0; bounce++) {
+            // Intersect
+            for (uint32_t i = 0; i < activeCount; i++) {
+                Ray ray{{queue.orgX[i], queue.orgY[i], queue.orgZ[i]}, {queue.dirX[i], queue.dirY[i], queue.dirZ[i]}};
+                queue.hits[i] = RayIntersectionTest(ray);
+            }
+            if (bounce == 0)
+                mCounters.primaryRays += activeCount;
+            else
+                mCounters.secondaryRays += activeCount;
+
+            // Miss, shade and extend
+            for (uint32_t i = 0; i < activeCount; i++) {
+                const HitInfo& hitInfo = queue.hits[i];
+                glm::vec3& radiance = queue.radiance[queue.pathIndex[i]];
+                glm::vec3 throughput(queue.throughputR[i], queue.throughputG[i], queue.throughputB[i]);
+                if (hitInfo.objIdx < 0) {
+                    radiance += RayMiss() * throughput;
+                    continue;
+                }
+
+                if (bounce == 0)
+                    queue.firstHit[queue.pathIndex[i]] = {mScene.materials[hitInfo.materialIndex].albedo, hitInfo.surfaceNormal, hitInfo.hitDistance};
+
+                Ray ray{{queue.orgX[i], queue.orgY[i], queue.orgZ[i]}, {queue.dirX[i], queue.dirY[i], queue.dirZ[i]}};
+                if (!ScatterRay(hitInfo, ray, throughput, radiance, queue.bsdfPdf[i], queue.sampler[i], bounce)) {
+                    queue.hits[i].objIdx = -1;      // Absorbed, compacted away like a miss
+                    continue;
+                }
+
+                queue.orgX[i] = ray.org.x; queue.orgY[i] = ray.org.y; queue.orgZ[i] = ray.org.z;
+                queue.dirX[i] = ray.dir.x; queue.dirY[i] = ray.dir.y; queue.dirZ[i] = ray.dir.z;
+                queue.throughputR[i] = throughput.r; queue.throughputG[i] = throughput.g; queue.throughputB[i] = throughput.b;
+            }
+
+            // Compact the paths that are still alive to the front of the queue
+            uint32_t alive = 0;
+            for (uint32_t i = 0; i < activeCount; i++) {
+                if (queue.hits[i].objIdx < 0)
+                    continue;
+                if (alive != i)
+                    queue.Move(i, alive);
+                alive++;
+            }
+            activeCount = alive;
+        }
+
+        // Samples of a pixel were generated next to each other, so they are added in the same order as TraceTile does
+        for (uint32_t i = 0; i < pathCount; i++)
+            AddSample(queue.pixel[i], queue.radiance[i], queue.firstHit[i]);
     }
 
-    glm::vec3 Renderer::RayMiss() {
-        return { 0.0f, 0.0f, 0.0f };
+    void Renderer::WavefrontQueue::Resize(uint32_t count) {
+        orgX.resize(count); orgY.resize(count); orgZ.resize(count);
+        dirX.resize(count); dirY.resize(count); dirZ.resize(count);
+        throughputR.resize(count); throughputG.resize(count); throughputB.resize(count);
+        pathIndex.resize(count);
+        sampler.resize(count);
+        bsdfPdf.resize(count);
+        pixel.resize(count);
+        hits.resize(count);
+        radiance.resize(count);
+        firstHit.resize(count);
+    }
+
+    void Renderer::WavefrontQueue::Move(uint32_t from, uint32_t to) {
+        orgX[to] = orgX[from]; orgY[to] = orgY[from]; orgZ[to] = orgZ[from];
+        dirX[to] = dirX[from]; dirY[to] = dirY[from]; dirZ[to] = dirZ[from];
+        throughputR[to] = throughputR[from]; throughputG[to] = throughputG[from]; throughputB[to] = throughputB[from];
+        pathIndex[to] = pathIndex[from];
+        sampler[to] = sampler[from];
+        bsdfPdf[to] = bsdfPdf[from];
+    }
+
+    // Interleaves the bits of x and y so tiles that are close on screen are close in the dispatch order
+    static uint32_t MortonCode(uint32_t x, uint32_t y) {
+        auto spread = [](uint32_t v) {
+            v &= 0x0000ffff;
+            v = (v | (v << 8)) & 0x00ff00ff;
+            v = (v | (v << 4)) & 0x0f0f0f0f;
+            v = (v | (v << 2)) & 0x33333333;
+            v = (v | (v << 1)) & 0x55555555;
+            return v;
+        };
+        return spread(x) | (spread(y) << 1);
+    }
+
+    void Renderer::OnResize(uint32_t width, uint32_t height) {
+        mAccumulation.Resize(width * height);
+        mLuminanceSquares.assign(width * height, 0.0f);
+        mSampleCounts.assign(width * height, 0);
+        mPixelConverged.assign(width * height, 0);
+        mGBuffer.Resize(width * height);
+        mHistoryUnverified.assign(width * height, 0);
+        mHasHistory = false;
+        mConvergedPixels = 0;
+
+        mTiles.clear();
+        for (uint32_t ty = 0; ty * TileSize < height; ty++) {
+            for (uint32_t tx = 0; tx * TileSize < width; tx++) {
+                Tile tile;
+                tile.x0 = tx * TileSize;
+                tile.y0 = ty * TileSize;
+                tile.x1 = std::min(tile.x0 + TileSize, width);
+                tile.y1 = std::min(tile.y0 + TileSize, height);
+                tile.order = MortonCode(tx, ty);
+                mTiles.push_back(tile);
+            }
+        }
+        std::sort(mTiles.begin(), mTiles.end(), [](const Tile& a, const Tile& b) { return a.order < b.order; });
+        mNextTile = 0;
+        mRenderedTileCount = 0;
+    }
+
+    void Renderer::SetThreadCount(uint32_t threadCount) {
+        mThreadPool.SetThreadCount(threadCount);
+    }
+
+    static AABB SphereBounds(const Core::Sphere& sphere) {
+        glm::vec3 extent = glm::vec3(glm::abs(sphere.radius));
+        return AABB{sphere.position - extent, sphere.position + extent};
+    }
+
+    void Renderer::BuildAccelerationStructure() {
+        BuildSphereBVH();
+        BuildMeshBVHs();
+    }
+
+    void Renderer::BuildSphereBVH() {
+        mSphereBounds.resize(mScene.spheres.size());
+        for (size_t i = 0; i < mScene.spheres.size(); i++)
+            mSphereBounds[i] = SphereBounds(mScene.spheres[i]);
+        mBVH.Build(mSphereBounds);
+        mSpheres.Build(mScene.spheres, mBVH.GetPrimitiveIndices());
+        mLightSampler.Build(mScene);
+    }
+
+    void Renderer::BuildMeshBVHs() {
+        mMeshBVHs.resize(mScene.meshes.size());
+        mThreadPool.ParallelFor(static_cast<uint32_t>(mMeshBVHs.size()), [&](uint32_t mesh, uint32_t) {
+            mMeshBVHs[mesh].Build(mScene.meshes[mesh]);
+        });
+        mInstanceBVH.Build(mScene, mMeshBVHs);
+        mBuiltInstanceCount = mScene.instances.size();
+    }
+
+    void Renderer::UpdateAccelerationStructure() {
+        // Meshes and instances are static, only a different count needs their trees rebuilt
+        if (mMeshBVHs.size() != mScene.meshes.size() || mBuiltInstanceCount != mScene.instances.size())
+            BuildMeshBVHs();
+
+        if (mScene.spheresAddedOrRemoved || mSphereBounds.size() != mScene.spheres.size()) {
+            BuildSphereBVH();
+            return;
+        }
+        if (mScene.dirtySpheres.empty())
+            return;
+
+        for (uint32_t idx : mScene.dirtySpheres) {
+            mSphereBounds[idx] = SphereBounds(mScene.spheres[idx]);
+            mSpheres.Update(idx, mScene.spheres[idx]);
+        }
+        mBVH.Refit(mScene.dirtySpheres, mSphereBounds);
+
+        if (mBVH.GetCostRatio() > settings.bvhRebuildThreshold)
+            BuildSphereBVH();
     }
 
-    glm::vec3 Renderer::ApplyGammaCorrection(const glm::vec3& color) {
-        glm::vec3 co = color;
-        if (color.r > 0) {
-            co.r = glm::pow(color.r, 1/gamma);
-        } if (color.g > 0) {
-            co.g = glm::pow(color.g, 1/gamma);
-        } if (color.b > 0) {
-            co.b = glm::pow(color.b, 1/gamma);
+    glm::vec3 Renderer::TraceRay(const Ray& pixelRay, SamplerState& sampler, FirstHit& firstHit) {
+        glm::vec3 contribution{1};
+        glm::vec3 incomingLight{0};
+        float bsdfPdf = 0.0f;
+        Ray ray = pixelRay;
+
+        for (int i = 0; i < settings.bounceLimit; i++) {
+            HitInfo hitInfo = RayIntersectionTest(ray);
+            if (i == 0)
+                mCounters.primaryRays++;
+            else
+                mCounters.secondaryRays++;
+            if (hitInfo.objIdx < 0) {
+                incomingLight += RayMiss() * contribution;
+                break;
+            }
+            if (i == 0)
+                firstHit = {mScene.materials[hitInfo.materialIndex].albedo, hitInfo.surfaceNormal, hitInfo.hitDistance};
+
+            if (!ScatterRay(hitInfo, ray, contribution, incomingLight, bsdfPdf, sampler, i))
+                break;
         }
-        return co;
+
+        return incomingLight;
     }
 
-    glm::vec3 Renderer::ApplyToneMapping(const glm::vec3& x) {
-        // Credit: Uncharted 2 filmic tonemapping
-        float A = 0.15f;
-        float B = 0.50f;
-        float C = 0.10f;
-        float D = 0.20f;
-        float E = 0.02f;
-        float F = 0.30f;
+    // Weight of a sample from one strategy when another one could have produced it too (Veach's power heuristic)
+    static float PowerHeuristic(float pdf, float otherPdf) {
+        float pdfSquared = pdf * pdf;
+        return pdfSquared / (pdfSquared + otherPdf * otherPdf);
+    }
+
+    /*
+     *  Before the BSDF is sampled a shadow ray goes to one light, emission from spheres that light sampling can also
+     *  reach is then weighted by multiple importance sampling between the two, so neither small bright spheres nor
+     *  large dim ones make the estimate noisy. Mirror bounces can't use light samples and keep all of the emission.
+    */
+    bool Renderer::ScatterRay(const HitInfo& hitInfo, Ray& ray, glm::vec3& contribution, glm::vec3& incomingLight, float& bsdfPdf,
+                              SamplerState& sampler, int depth) {
+        const glm::vec3& hitNorm = hitInfo.surfaceNormal;
+        BSDF bsdf(mScene.materials[hitInfo.materialIndex], hitNorm);
+        glm::vec3 wo = -ray.dir;
+        uint32_t dimension = sampler.dimension;
+        sampler.dimension += SampleDimension::PerBounce;
+        glm::vec2 uSelect = mSampler.Get2D(sampler, dimension + SampleDimension::LightSelection);
+
+        incomingLight += EmittedLight(hitInfo, ray, bsdfPdf) * contribution;
+
+        glm::vec3 position = hitInfo.worldPosition + hitNorm * 0.0001f;
+        if (settings.sampleLights && bsdf.HasNonSpecular() && !mLightSampler.IsEmpty()) {
+            glm::vec2 u = mSampler.Get2D(sampler, dimension + SampleDimension::Light);
+            LightSample light;
+            if (mLightSampler.Sample(mScene, position, uSelect.x, u.x, u.y, light)) {
+                float lightBsdfPdf;
+                glm::vec3 value = bsdf.Evaluate(wo, light.direction, lightBsdfPdf);
+                if (lightBsdfPdf > 0.0f && !Occluded(position, light.direction, light.distance * 0.9999f)) {
+                    float weight = light.isDelta ? 1.0f : PowerHeuristic(light.pdf, lightBsdfPdf);
+                    incomingLight += contribution * value * light.radiance * (weight / light.pdf);
+                }
+            }
+        }
+
+        glm::vec2 u = mSampler.Get2D(sampler, dimension + SampleDimension::BSDF);
+        BSDFSample sample;
+        if (!bsdf.Sample(wo, uSelect.y, u.x, u.y, sample))
+            return false;
+        ray.org = position;
+        ray.dir = sample.direction;
+        bsdfPdf = sample.pdf;
+        contribution *= sample.weight;
 
-        return ((x*(A*x+C*B)+D*E)/(x*(A*x+B)+D*F))-E/F;
+        // Survival in proportion to the throughput, capped so bright paths still end once in a while
+        if (settings.russianRoulette && depth >= settings.russianRouletteDepth) {
+            float survival = std::min(glm::max(contribution.r, glm::max(contribution.g, contribution.b)), 0.95f);
+            if (mSampler.Get1D(sampler, dimension + SampleDimension::Termination) >= survival)
+                return false;
+            contribution /= survival;
+        }
+        return true;
     }
 
-    float Renderer::RandomValue(uint32_t& state) {
-        return (float)NextRandom(state) / (float)4294967295.0; // 2^32 - 1
+    glm::vec3 Renderer::EmittedLight(const HitInfo& hitInfo, const Ray& ray, float bsdfPdf) {
+        const Core::Material& mat = mScene.materials[hitInfo.materialIndex];
+        glm::vec3 emitted = mat.emissionColor * mat.emissionStrength;
+        // Meshes aren't light sampled, and neither is anything reached from the camera or a mirror
+        if (!settings.sampleLights || bsdfPdf <= 0.0f || hitInfo.instanceIndex >= 0 || emitted == glm::vec3(0.0f))
+            return emitted;
+
+        // The ray starts at the previous vertex, which is where its light sample was taken from
+        float lightPdf = mLightSampler.SpherePdf(mScene, static_cast<uint32_t>(hitInfo.objIdx), ray.org);
+        return emitted * PowerHeuristic(bsdfPdf, lightPdf);
     }
 
-    uint32_t Renderer::NextRandom(uint32_t& state) {
-        state = state * 747796405 + 2891336453;
-        uint32_t result = ((state >> ((state >> 28) + 4)) ^ state) * 277803737;
-        result = (result >> 22) ^ result;
-        return result;
+    bool Renderer::Occluded(const glm::vec3& org, const glm::vec3& dir, float tmax) {
+        mCounters.shadowRays++;
+        bool occluded = false;
+        if (settings.useBVH) {
+            float traversalMax = tmax;
+            mCounters.bvhNodeVisits += mBVH.Traverse(org, dir, traversalMax, [&](uint32_t first, uint32_t count) {
+                float t = traversalMax;
+                mCounters.intersectionTests += count;
+                if (mIntersectSpheres(mSpheres, first, count, org, dir, t) >= 0) {
+                    occluded = true;
+                    traversalMax = -1.0f;
+                }
+            });
+        } else {
+            float t = tmax;
+            occluded = mIntersectSpheres(mSpheres, 0, mSpheres.count, org, dir, t) >= 0;
+            mCounters.intersectionTests += mSpheres.count;
+        }
+        return occluded || mInstanceBVH.Occluded(mScene, org, dir, tmax, mCounters.bvhNodeVisits, mCounters.intersectionTests);
     }
 
-    float Renderer::RandomValueNormalDistribution(uint32_t& state) {
-        float theta = 2 * glm::pi<float>() * RandomValue(state);
-        float rho = glm::sqrt(-2 * glm::log(RandomValue(state)));
-        return rho * glm::cos(theta);
+    Renderer::HitInfo Renderer::RayIntersectionTest(const Ray& ray) {
+        float tmin = FLT_MAX;
+        int hitSlot = -1;
+
+        if (settings.useBVH) {
+            mCounters.bvhNodeVisits += mBVH.Traverse(ray.org, ray.dir, tmin, [&](uint32_t first, uint32_t count) {
+                int slot = mIntersectSpheres(mSpheres, first, count, ray.org, ray.dir, tmin);
+                if (slot >= 0)
+                    hitSlot = slot;
+                mCounters.intersectionTests += count;
+            });
+        } else {
+            hitSlot = mIntersectSpheres(mSpheres, 0, mSpheres.count, ray.org, ray.dir, tmin);
+            mCounters.intersectionTests += mSpheres.count;
+        }
+
+        // Meshes always go through the two level hierarchy, without it a large mesh would take seconds per ray.
+        // tmin carries over so it only looks for hits in front of the closest sphere.
+        InstanceBVH::Hit meshHit = mInstanceBVH.Intersect(mScene, ray.org, ray.dir, tmin, mCounters.bvhNodeVisits, mCounters.intersectionTests);
+
+        HitInfo hitInfo{};
+        if (meshHit.instance >= 0) {
+            hitInfo.worldPosition = ray.org + tmin * ray.dir;
+            hitInfo.surfaceNormal = mInstanceBVH.GetNormal(mScene, meshHit, ray.dir);
+            hitInfo.hitDistance = tmin;
+            hitInfo.objIdx = meshHit.triangle;
+            hitInfo.instanceIndex = meshHit.instance;
+            hitInfo.materialIndex = mInstanceBVH.GetMaterialIndex(meshHit.instance);
+            return hitInfo;
+        }
+        if (hitSlot < 0) {
+            return hitInfo;
+        }
+
+        glm::vec3 spherePosition(mSpheres.x[hitSlot], mSpheres.y[hitSlot], mSpheres.z[hitSlot]);
+        hitInfo.worldPosition = ray.org + tmin * ray.dir;
+        hitInfo.surfaceNormal = glm::normalize(hitInfo.worldPosition - spherePosition);
+        hitInfo.hitDistance = tmin;
+        hitInfo.objIdx = static_cast<int>(mSpheres.sceneIndex[hitSlot]);
+        hitInfo.materialIndex = mSpheres.materialIndex[hitSlot];
+        return hitInfo;
     }
 
-    glm::vec3 Renderer::RandomDirection(uint32_t& state) {
-        float x = RandomValueNormalDistribution(state);
-        float y = RandomValueNormalDistribution(state);
-        float z = RandomValueNormalDistribution(state);
-        return glm::vec3(x, y, z);
+    glm::vec3 Renderer::RayMiss() {
+        return mScene.skyLight.color * mScene.skyLight.strength;
     }
 
 }
@@ -0,0 +1,106 @@
+#include <Reprojection.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <limits>
+
+namespace RT {
+
+    static constexpr uint64_t EmptyTarget = ~0ull;
+    static constexpr uint32_t RowsPerTask = 16;
+    static constexpr float MinCoverage = 0.5f;
+
+    void Reprojection::Build(const glm::mat4& previousView, const glm::mat4& previousProjection, const Core::Camera& camera,
+                             const GBuffer& gbuffer, const std::vector<uint32_t>& sampleCounts, uint32_t width, uint32_t height,
+                             ThreadPool& threadPool) {
+        size_t pixelCount = static_cast<size_t>(width) * height;
+        mTargets.assign(pixelCount, EmptyTarget);
+        mSources.resize(pixelCount);
+        mDepths.resize(pixelCount);
+
+        glm::mat4 inverseView = glm::inverse(previousView);
+        glm::mat4 inverseProjection = glm::inverse(previousProjection);
+        glm::vec3 previousPosition = glm::vec3(inverseView[3]);
+        glm::mat4 viewProjection = camera.GetProjection() * camera.GetView();
+        const glm::vec3& position = camera.GetPosition();
+        glm::vec2 size(static_cast<float>(width), static_cast<float>(height));
+        uint32_t taskCount = (height + RowsPerTask - 1) / RowsPerTask;
+
+        threadPool.ParallelFor(taskCount, [&](uint32_t task, uint32_t) {
+            uint32_t y1 = std::min((task + 1) * RowsPerTask, height);
+            for (uint32_t y = task * RowsPerTask; y < y1; y++) {
+                for (uint32_t x = 0; x < width; x++) {
+                    uint32_t pixelIndex = x + y * width;
+                    if (sampleCounts[pixelIndex] == 0)
+                        continue;
+
+                    // Through the pixel's center, where its jittered samples average out
+                    glm::vec2 ndc = (glm::vec2(static_cast<float>(x), static_cast<float>(y)) + 0.5f) / size * 2.0f - 1.0f;
+                    glm::vec4 target = inverseProjection * glm::vec4(ndc.x, ndc.y, 1, 1);
+                    glm::vec3 direction = glm::vec3(inverseView * glm::vec4(glm::normalize(glm::vec3(target) / target.w), 0));
+
+                    // Misses average in as zero depth and zero normal. The mean normal's length is close to the share
+                    // of samples that hit something, which gives back the depth of the hits at the edge of the sky.
+                    // Pixels that mostly missed, or whose samples scattered in all directions, move like the sky.
+                    float coverage = glm::length(glm::vec3(gbuffer.normalX[pixelIndex], gbuffer.normalY[pixelIndex], gbuffer.normalZ[pixelIndex]));
+                    float depth = coverage >= MinCoverage ? gbuffer.depth[pixelIndex] / std::min(coverage, 1.0f) : 0.0f;
+
+                    // Misses are directions and project without the camera's translation
+                    float distance = std::numeric_limits<float>::infinity();
+                    glm::vec4 clip;
+                    if (depth > 0.0f) {
+                        glm::vec3 world = previousPosition + direction * depth;
+                        clip = viewProjection * glm::vec4(world, 1);
+                        distance = glm::length(world - position);
+                    } else {
+                        clip = viewProjection * glm::vec4(direction, 0);
+                    }
+                    if (clip.w <= 0.0f)
+                        continue;
+                    glm::vec2 screen = (glm::vec2(clip.x, clip.y) / clip.w * 0.5f + 0.5f) * size;
+                    if (screen.x < 0.0f || screen.y < 0.0f || screen.x >= size.x || screen.y >= size.y)
+                        continue;
+
+                    uint32_t targetIndex = static_cast<uint32_t>(screen.x) + static_cast<uint32_t>(screen.y) * width;
+                    uint64_t value = (static_cast<uint64_t>(std::bit_cast<uint32_t>(distance)) << 32) | pixelIndex;
+                    std::atomic_ref<uint64_t> slot(mTargets[targetIndex]);
+                    uint64_t current = slot.load(std::memory_order_relaxed);
+                    while (value < current && !slot.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+                    }
+                }
+            }
+        });
+
+        threadPool.ParallelFor(taskCount, [&](uint32_t task, uint32_t) {
+            uint32_t y1 = std::min((task + 1) * RowsPerTask, height);
+            for (uint32_t y = task * RowsPerTask; y < y1; y++) {
+                for (uint32_t x = 0; x < width; x++) {
+                    uint32_t pixelIndex = x + y * width;
+                    uint64_t value = mTargets[pixelIndex];
+                    // A crack has history on both sides, the edge of a disocclusion only on one
+                    if (value == EmptyTarget && x > 0 && x + 1 < width) {
+                        uint64_t left = mTargets[pixelIndex - 1], right = mTargets[pixelIndex + 1];
+                        if (left != EmptyTarget && right != EmptyTarget)
+                            value = std::min(left, right);
+                    }
+                    if (value == EmptyTarget && y > 0 && y + 1 < height) {
+                        uint64_t up = mTargets[pixelIndex - width], down = mTargets[pixelIndex + width];
+                        if (up != EmptyTarget && down != EmptyTarget)
+                            value = std::min(up, down);
+                    }
+
+                    if (value == EmptyTarget) {
+                        mSources[pixelIndex] = NoSource;
+                        mDepths[pixelIndex] = 0.0f;
+                        continue;
+                    }
+                    float distance = std::bit_cast<float>(static_cast<uint32_t>(value >> 32));
+                    mSources[pixelIndex] = static_cast<int32_t>(value & 0xffffffffu);
+                    mDepths[pixelIndex] = distance == std::numeric_limits<float>::infinity() ? 0.0f : distance;
+                }
+            }
+        });
+    }
+
+}
@@ -0,0 +1,238 @@
+#include <Sampler.h>
+
+#include <array>
+#include <cmath>
+#include <vector>
+
+namespace RT {
+
+    static constexpr uint32_t BlueNoiseSize = 64;
+    static constexpr uint32_t BlueNoisePixels = BlueNoiseSize * BlueNoiseSize;
+
+    // 1 / plastic number and its square, the R2 sequence's steps (Roberts 2018), as 32-bit fixed point
+    static constexpr uint32_t R2Step[2] = { 3242174889u, 2447445414u };
+
+    static float ToUnitFloat(uint32_t value) {
+        return static_cast<float>(value >> 8) * 0x1p-24f;   // Top 24 bits so the result stays below 1
+    }
+
+    // Integer hash with low bias (Wellons' lowbias32)
+    static uint32_t Hash(uint32_t x) {
+        x ^= x >> 16;
+        x *= 0x7feb352du;
+        x ^= x >> 15;
+        x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    static uint32_t HashCombine(uint32_t seed, uint32_t value) {
+        return Hash(seed ^ (value + 0x9e3779b9u + (seed << 6) + (seed >> 2)));
+    }
+
+    static uint32_t NextRandom(uint32_t& state) {
+        state = state * 747796405 + 2891336453;
+        uint32_t result = ((state >> ((state >> 28) + 4)) ^ state) * 277803737;
+        result = (result >> 22) ^ result;
+        return result;
+    }
+
+    static uint32_t ReverseBits(uint32_t x) {
+        x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+        x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+        x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+        x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+        return (x >> 16) | (x << 16);
+    }
+
+    // Owen scrambling of a bit reversed value as a single hash (Laine and Karras 2011, constants by Burley 2020)
+    static uint32_t LaineKarrasPermutation(uint32_t x, uint32_t seed) {
+        x += seed;
+        x ^= x * 0x6c50b47cu;
+        x ^= x * 0xb82f1e52u;
+        x ^= x * 0xc7afe638u;
+        x ^= x * 0x8d22f6e6u;
+        return x;
+    }
+
+    static uint32_t NestedUniformScramble(uint32_t x, uint32_t seed) {
+        return ReverseBits(LaineKarrasPermutation(ReverseBits(x), seed));
+    }
+
+    // Second Sobol dimension, the first one is the bit reversed index. The direction numbers of every byte of the
+    // index are combined ahead of time, so a point takes four lookups instead of one XOR per set bit.
+    static constexpr std::array<std::array<uint32_t, 256>, 4> SobolSecondTable = [] {
+        std::array<uint32_t, 32> directions{};
+        uint32_t v = 1u << 31;
+        for (uint32_t i = 0; i < 32; i++, v ^= v >> 1)
+            directions[i] = v;
+
+        std::array<std::array<uint32_t, 256>, 4> table{};
+        for (uint32_t byte = 0; byte < 4; byte++) {
+            for (uint32_t value = 0; value < 256; value++) {
+                for (uint32_t bit = 0; bit < 8; bit++) {
+                    if (value & (1u << bit))
+                        table[byte][value] ^= directions[8 * byte + bit];
+                }
+            }
+        }
+        return table;
+    }();
+
+    static uint32_t SobolSecond(uint32_t index) {
+        return SobolSecondTable[0][index & 0xff] ^ SobolSecondTable[1][(index >> 8) & 0xff] ^
+               SobolSecondTable[2][(index >> 16) & 0xff] ^ SobolSecondTable[3][index >> 24];
+    }
+
+    /*
+     *  Void and cluster (Ulichney 1993) over a torus: points are added one at a time where the Gaussian weighted
+     *  density of the points so far is lowest, their order is the mask value. Any threshold of the mask is then
+     *  a blue noise pattern, so neighbouring pixels get values far apart.
+    */
+    static std::vector<uint32_t> BuildBlueNoiseMask() {
+        constexpr float Sigma = 1.5f;
+        std::vector<float> kernel(BlueNoisePixels);
+        for (uint32_t y = 0; y < BlueNoiseSize; y++) {
+            for (uint32_t x = 0; x < BlueNoiseSize; x++) {
+                float dx = static_cast<float>(std::min(x, BlueNoiseSize - x));
+                float dy = static_cast<float>(std::min(y, BlueNoiseSize - y));
+                kernel[y * BlueNoiseSize + x] = std::exp(-(dx * dx + dy * dy) / (2.0f * Sigma * Sigma));
+            }
+        }
+
+        std::vector<uint8_t> pattern(BlueNoisePixels, 0);
+        std::vector<float> energy(BlueNoisePixels, 0.0f);
+        auto splat = [&](std::vector<float>& target, uint32_t pixel, float sign) {
+            uint32_t px = pixel % BlueNoiseSize, py = pixel / BlueNoiseSize;
+            for (uint32_t y = 0; y < BlueNoiseSize; y++) {
+                const float* row = &kernel[((y - py) & (BlueNoiseSize - 1)) * BlueNoiseSize];
+                for (uint32_t x = 0; x < BlueNoiseSize; x++)
+                    target[y * BlueNoiseSize + x] += sign * row[(x - px) & (BlueNoiseSize - 1)];
+            }
+        };
+        // Set pixel with the most set neighbours, or empty pixel with the fewest
+        auto tightestCluster = [&](const std::vector<uint8_t>& bits, const std::vector<float>& density) {
+            uint32_t best = 0;
+            float bestEnergy = -1.0f;
+            for (uint32_t i = 0; i < BlueNoisePixels; i++) {
+                if (bits[i] && density[i] > bestEnergy) {
+                    bestEnergy = density[i];
+                    best = i;
+                }
+            }
+            return best;
+        };
+        auto largestVoid = [&](const std::vector<uint8_t>& bits, const std::vector<float>& density) {
+            uint32_t best = 0;
+            float bestEnergy = 1e30f;
+            for (uint32_t i = 0; i < BlueNoisePixels; i++) {
+                if (!bits[i] && density[i] < bestEnergy) {
+                    bestEnergy = density[i];
+                    best = i;
+                }
+            }
+            return best;
+        };
+
+        // Random initial pattern, relaxed by moving points from the tightest cluster into the largest void
+        uint32_t rng = 1;
+        uint32_t initialCount = BlueNoisePixels / 10;
+        for (uint32_t placed = 0; placed < initialCount;) {
+            uint32_t pixel = NextRandom(rng) % BlueNoisePixels;
+            if (pattern[pixel])
+                continue;
+            pattern[pixel] = 1;
+            splat(energy, pixel, 1.0f);
+            placed++;
+        }
+        for (;;) {
+            uint32_t cluster = tightestCluster(pattern, energy);
+            pattern[cluster] = 0;
+            splat(energy, cluster, -1.0f);
+            uint32_t gap = largestVoid(pattern, energy);
+            pattern[gap] = 1;
+            splat(energy, gap, 1.0f);
+            if (gap == cluster)
+                break;
+        }
+
+        // Initial points get the lowest ranks, removed cluster by cluster, everything else fills the voids. With
+        // a Gaussian that sums to the same value everywhere the largest void of the set pixels is also the tightest
+        // cluster of the empty ones, so the second half of Ulichney's fill needs no extra case.
+        std::vector<uint32_t> rank(BlueNoisePixels);
+        std::vector<uint8_t> removing = pattern;
+        std::vector<float> removingEnergy = energy;
+        for (uint32_t r = initialCount; r-- > 0;) {
+            uint32_t cluster = tightestCluster(removing, removingEnergy);
+            removing[cluster] = 0;
+            splat(removingEnergy, cluster, -1.0f);
+            rank[cluster] = r;
+        }
+        for (uint32_t r = initialCount; r < BlueNoisePixels; r++) {
+            uint32_t gap = largestVoid(pattern, energy);
+            pattern[gap] = 1;
+            splat(energy, gap, 1.0f);
+            rank[gap] = r;
+        }
+
+        // Centers of the rank intervals in 32-bit fixed point
+        std::vector<uint32_t> mask(BlueNoisePixels);
+        for (uint32_t i = 0; i < BlueNoisePixels; i++)
+            mask[i] = static_cast<uint32_t>((2ull * rank[i] + 1ull) * (1ull << 31) / BlueNoisePixels);
+        return mask;
+    }
+
+    static const std::vector<uint32_t>& BlueNoiseMask() {
+        static const std::vector<uint32_t> mask = BuildBlueNoiseMask();
+        return mask;
+    }
+
+    void Sampler::SetType(SamplerType type) {
+        mType = type;
+        if (type == SamplerType::BlueNoise && !mBlueNoise)
+            mBlueNoise = BlueNoiseMask().data();
+    }
+
+    SamplerState Sampler::Start(uint32_t x, uint32_t y, uint32_t width, uint32_t sampleIndex) const {
+        uint32_t pixelIndex = x + y * width;
+        SamplerState state{x, y, sampleIndex, SampleDimension::FirstBounce, Hash(pixelIndex)};
+        // Seeds of neighbouring pixels and samples go through the hash, plain sums of them made correlated streams
+        if (mType == SamplerType::PCG)
+            state.seed = HashCombine(state.seed, sampleIndex);
+        return state;
+    }
+
+    float Sampler::Get1D(SamplerState& state, uint32_t dimension) const {
+        switch (mType) {
+        case SamplerType::Sobol: {
+            // Both dimensions of a pair share the shuffled index, which keeps the pair stratified in 2D
+            uint32_t pairSeed = HashCombine(state.seed, dimension >> 1);
+            uint32_t index = NestedUniformScramble(state.index, pairSeed);
+            uint32_t value = (dimension & 1) ? SobolSecond(index) : ReverseBits(index);
+            return ToUnitFloat(NestedUniformScramble(value, HashCombine(pairSeed, dimension & 1)));
+        }
+        case SamplerType::BlueNoise: {
+            // Every dimension reads the mask at its own toroidal offset so dimensions of a pixel aren't correlated
+            uint32_t offset = Hash(dimension);
+            uint32_t mx = (state.x + offset) & (BlueNoiseSize - 1);
+            uint32_t my = (state.y + (offset >> 6)) & (BlueNoiseSize - 1);
+            return ToUnitFloat(mBlueNoise[my * BlueNoiseSize + mx] + state.index * R2Step[dimension & 1]);
+        }
+        case SamplerType::PCG:
+            return ToUnitFloat(NextRandom(state.seed));
+        }
+        return 0.0f;
+    }
+
+    glm::vec2 Sampler::Get2D(SamplerState& state, uint32_t dimension) const {
+        if (mType == SamplerType::Sobol) {
+            uint32_t pairSeed = HashCombine(state.seed, dimension >> 1);
+            uint32_t index = NestedUniformScramble(state.index, pairSeed);
+            return glm::vec2(ToUnitFloat(NestedUniformScramble(ReverseBits(index), HashCombine(pairSeed, 0))),
+                             ToUnitFloat(NestedUniformScramble(SobolSecond(index), HashCombine(pairSeed, 1))));
+        }
+        float u0 = Get1D(state, dimension);
+        return glm::vec2(u0, Get1D(state, dimension + 1));
+    }
+
+}
@@ -0,0 +1,34 @@
+#include <Scene.h>
+
+namespace Core {
+
+    Scene CreateDefaultScene() {
+        Scene scene;
+        scene.materials.push_back({glm::vec3(124.0f/255.0f, 252.0f/255.0f, 0.0f)});
+        scene.materials.push_back({glm::vec3(1.0f, 46.0f/255.0f, 0.0f), glm::vec3(0.0f, 191.0f/255.0f, 21.0f/255.0f), 20.0f});
+        scene.materials.push_back({glm::vec3(204.0f/255.0f, 128.0f/255.0f, 51.0f/255.0f)});
+
+        {
+            Sphere sphere;
+            sphere.position = glm::vec3(0.0f, -100.5f, 0.0f);
+            sphere.radius = 100.0f;
+            sphere.materialIndex = 0;
+            scene.spheres.push_back(sphere);
+        }
+        {
+            Sphere sphere;
+            sphere.position = glm::vec3(33.0f, 4.0f, -32.0f);
+            sphere.radius = 20.0f;
+            sphere.materialIndex = 1;
+            scene.spheres.push_back(sphere);
+        }
+        {
+            Sphere sphere;
+            sphere.materialIndex = 2;
+            scene.spheres.push_back(sphere);
+        }
+
+        return scene;
+    }
+
+}
@@ -0,0 +1,451 @@
+#include <SceneFile.h>
+#include <MappedFile.h>
+#include <MeshFile.h>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <type_traits>
+
+namespace Core {
+
+    static bool HasExtension(const std::string& path, const std::string& extension) {
+        return path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+    }
+
+    static bool HasMaterial(const Scene& scene, int materialIndex) {
+        return materialIndex >= 0 && static_cast<size_t>(materialIndex) < scene.materials.size();
+    }
+
+    // Negative instance materials keep the mesh's
+    static bool IsValidInstance(const Scene& scene, const Instance& instance) {
+        return instance.meshIndex < scene.meshes.size() && (instance.materialIndex < 0 || HasMaterial(scene, instance.materialIndex));
+    }
+
+    bool LoadScene(const std::string& path, Scene& scene, CameraSettings& camera) {
+        if (HasExtension(path, ".rtsb"))
+            return LoadSceneBinary(path, scene, camera);
+        return LoadSceneText(path, scene, camera);
+    }
+
+    bool SaveScene(const std::string& path, const Scene& scene, const CameraSettings& camera) {
+        if (HasExtension(path, ".rtsb"))
+            return SaveSceneBinary(path, scene, camera);
+        return SaveSceneText(path, scene, camera);
+    }
+
+    bool LoadSceneText(const std::string& path, Scene& scene, CameraSettings& camera) {
+        std::ifstream file(path);
+        if (!file) {
+            std::cerr << "Failed to open scene " << path << "\n";
+            return false;
+        }
+
+        scene = Scene{};
+        camera = CameraSettings{};
+        // Mesh paths are relative to the scene file
+        std::filesystem::path directory = std::filesystem::path(path).parent_path();
+
+        std::string line;
+        uint32_t lineNumber = 0;
+        std::vector<uint32_t> sphereLines;
+        std::vector<uint32_t> meshLines;
+        std::vector<uint32_t> instanceLines;
+        while (std::getline(file, line)) {
+            lineNumber++;
+            size_t comment = line.find('#');
+            if (comment != std::string::npos)
+                line.resize(comment);
+
+            std::istringstream stream(line);
+            std::string type;
+            if (!(stream >> type))
+                continue;
+
+            bool valid = false;
+            if (type == "sky") {
+                SkyLight& sky = scene.skyLight;
+                valid = static_cast<bool>(stream >> sky.color.r >> sky.color.g >> sky.color.b >> sky.strength);
+            } else if (type == "material") {
+                Material mat;
+                valid = static_cast<bool>(stream >> mat.albedo.r >> mat.albedo.g >> mat.albedo.b
+                                                 >> mat.emissionColor.r >> mat.emissionColor.g >> mat.emissionColor.b
+                                                 >> mat.emissionStrength >> mat.shininess);
+                scene.materials.push_back(mat);
+            } else if (type == "sphere") {
+                Sphere sphere;
+                valid = static_cast<bool>(stream >> sphere.position.x >> sphere.position.y >> sphere.position.z
+                                                 >> sphere.radius >> sphere.materialIndex);
+                scene.spheres.push_back(sphere);
+                sphereLines.push_back(lineNumber);
+            } else if (type == "dirlight") {
+                DirectionalLight light;
+                valid = static_cast<bool>(stream >> light.direction.x >> light.direction.y >> light.direction.z
+                                                 >> light.color.r >> light.color.g >> light.color.b >> light.intensity);
+                scene.directionalLights.push_back(light);
+            } else if (type == "pointlight") {
+                PointLight light;
+                valid = static_cast<bool>(stream >> light.Position.x >> light.Position.y >> light.Position.z
+                                                 >> light.color.r >> light.color.g >> light.color.b >> light.intensity);
+                scene.pointLights.push_back(light);
+            } else if (type == "mesh") {
+                // The path is the rest of the line so it may contain spaces
+                int materialIndex = 0;
+                std::string meshPath;
+                valid = static_cast<bool>(stream >> materialIndex) && std::getline(stream >> std::ws, meshPath) && !meshPath.empty();
+                if (valid) {
+                    while (std::isspace(static_cast<unsigned char>(meshPath.back())))
+                        meshPath.pop_back();
+                    Mesh mesh;
+                    if (!LoadMesh((directory / meshPath).string(), mesh))
+                        return false;
+                    mesh.materialIndex = materialIndex;
+                    scene.meshes.push_back(std::move(mesh));
+                    meshLines.push_back(lineNumber);
+                }
+            } else if (type == "instance") {
+                // Rows of the 3x4 object to world matrix follow the indices
+                Instance instance;
+                valid = static_cast<bool>(stream >> instance.meshIndex >> instance.materialIndex);
+                for (int row = 0; row < 3 && valid; row++) {
+                    for (int column = 0; column < 4 && valid; column++)
+                        valid = static_cast<bool>(stream >> instance.transform[column][row]);
+                }
+                scene.instances.push_back(instance);
+                instanceLines.push_back(lineNumber);
+            } else if (type == "camera") {
+                valid = static_cast<bool>(stream >> camera.position.x >> camera.position.y >> camera.position.z
+                                                 >> camera.fov >> camera.nearClip >> camera.farClip);
+            } else {
+                std::cerr << path << ":" << lineNumber << ": unknown entry '" << type << "'\n";
+                return false;
+            }
+
+            if (!valid) {
+                std::cerr << path << ":" << lineNumber << ": malformed '" << type << "' entry\n";
+                return false;
+            }
+        }
+
+        // Entries may come in any order, so references are checked once every material is known
+        for (size_t i = 0; i < scene.spheres.size(); i++) {
+            if (!HasMaterial(scene, scene.spheres[i].materialIndex)) {
+                std::cerr << path << ":" << sphereLines[i] << ": material index " << scene.spheres[i].materialIndex
+                          << " out of range, the scene has " << scene.materials.size() << " materials\n";
+                return false;
+            }
+        }
+        for (size_t i = 0; i < scene.meshes.size(); i++) {
+            if (!HasMaterial(scene, scene.meshes[i].materialIndex)) {
+                std::cerr << path << ":" << meshLines[i] << ": material index " << scene.meshes[i].materialIndex
+                          << " out of range, the scene has " << scene.materials.size() << " materials\n";
+                return false;
+            }
+        }
+        for (size_t i = 0; i < scene.instances.size(); i++) {
+            if (!IsValidInstance(scene, scene.instances[i])) {
+                std::cerr << path << ":" << instanceLines[i] << ": instance of mesh " << scene.instances[i].meshIndex << " with material "
+                          << scene.instances[i].materialIndex << ", the scene has " << scene.meshes.size() << " meshes and "
+                          << scene.materials.size() << " materials\n";
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Shortest text that reads back as the same float, so saved scenes stay readable and lossless
+    static std::string FormatFloat(float value) {
+        char buffer[32];
+        std::to_chars_result result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        return std::string(buffer, result.ptr);
+    }
+
+    bool SaveSceneText(const std::string& path, const Scene& scene, const CameraSettings& camera) {
+        std::ofstream file(path);
+        if (!file) {
+            std::cerr << "Failed to create scene " << path << "\n";
+            return false;
+        }
+
+        const SkyLight& sky = scene.skyLight;
+        file << "camera " << FormatFloat(camera.position.x) << " " << FormatFloat(camera.position.y) << " " << FormatFloat(camera.position.z) << " "
+             << FormatFloat(camera.fov) << " " << FormatFloat(camera.nearClip) << " " << FormatFloat(camera.farClip) << "\n";
+        file << "sky " << FormatFloat(sky.color.r) << " " << FormatFloat(sky.color.g) << " " << FormatFloat(sky.color.b) << " " << FormatFloat(sky.strength) << "\n";
+
+        for (const Material& mat : scene.materials) {
+            file << "material " << FormatFloat(mat.albedo.r) << " " << FormatFloat(mat.albedo.g) << " " << FormatFloat(mat.albedo.b) << " "
+                 << FormatFloat(mat.emissionColor.r) << " " << FormatFloat(mat.emissionColor.g) << " " << FormatFloat(mat.emissionColor.b) << " "
+                 << FormatFloat(mat.emissionStrength) << " " << FormatFloat(mat.shininess) << "\n";
+        }
+        for (const Sphere& sphere : scene.spheres) {
+            file << "sphere " << FormatFloat(sphere.position.x) << " " << FormatFloat(sphere.position.y) << " " << FormatFloat(sphere.position.z) << " "
+                 << FormatFloat(sphere.radius) << " " << sphere.materialIndex << "\n";
+        }
+        for (const DirectionalLight& light : scene.directionalLights) {
+            file << "dirlight " << FormatFloat(light.direction.x) << " " << FormatFloat(light.direction.y) << " " << FormatFloat(light.direction.z) << " "
+                 << FormatFloat(light.color.r) << " " << FormatFloat(light.color.g) << " " << FormatFloat(light.color.b) << " " << FormatFloat(light.intensity) << "\n";
+        }
+        for (const PointLight& light : scene.pointLights) {
+            file << "pointlight " << FormatFloat(light.Position.x) << " " << FormatFloat(light.Position.y) << " " << FormatFloat(light.Position.z) << " "
+                 << FormatFloat(light.color.r) << " " << FormatFloat(light.color.g) << " " << FormatFloat(light.color.b) << " " << FormatFloat(light.intensity) << "\n";
+        }
+
+        // Text scenes only reference mesh files, written relative to the scene so the two can be moved together
+        std::filesystem::path directory = std::filesystem::absolute(path).parent_path();
+        for (const Mesh& mesh : scene.meshes) {
+            if (mesh.source.empty()) {
+                std::cerr << "Skipping a mesh that wasn't loaded from a file, only binary scenes can store it\n";
+                continue;
+            }
+            std::filesystem::path source = std::filesystem::absolute(mesh.source);
+            std::filesystem::path relative = source.lexically_relative(directory);
+            file << "mesh " << mesh.materialIndex << " " << (relative.empty() ? source : relative).generic_string() << "\n";
+        }
+        for (const Instance& instance : scene.instances) {
+            file << "instance " << instance.meshIndex << " " << instance.materialIndex;
+            for (int row = 0; row < 3; row++) {
+                for (int column = 0; column < 4; column++)
+                    file << " " << FormatFloat(instance.transform[column][row]);
+            }
+            file << "\n";
+        }
+
+        return static_cast<bool>(file);
+    }
+
+    // The binary format stores the scene structs as they are in memory, so it is only portable between
+    // little endian machines where glm packs its vectors tightly
+    static_assert(std::is_trivially_copyable_v<Material>);
+    static_assert(std::is_trivially_copyable_v<Sphere>);
+    static_assert(std::is_trivially_copyable_v<DirectionalLight>);
+    static_assert(std::is_trivially_copyable_v<PointLight>);
+    static_assert(std::is_trivially_copyable_v<Instance>);
+    static_assert(sizeof(Sphere) == 20 && sizeof(Material) == 32 && sizeof(Instance) == 72);
+
+    static constexpr char BinaryMagic[4] = {'R', 'T', 'S', 'B'};
+    // Version 2 appended the mesh arrays to the header and version 3 the instances, older files still load
+    static constexpr uint32_t BinaryVersion = 3;
+    static constexpr uint64_t BinaryAlignment = 16;
+
+    struct BinaryArray {
+        uint64_t offset = 0;
+        uint64_t count = 0;
+    };
+
+    struct BinaryHeader {
+        char magic[4];
+        uint32_t version;
+        SkyLight skyLight;
+        CameraSettings camera;
+        BinaryArray materials;
+        BinaryArray spheres;
+        BinaryArray directionalLights;
+        BinaryArray pointLights;
+        BinaryArray meshes;         // BinaryMesh descriptors into the arrays below
+        BinaryArray meshX;
+        BinaryArray meshY;
+        BinaryArray meshZ;
+        BinaryArray meshIndices;
+        BinaryArray instances;
+    };
+
+    // Size of the header written by each version, the fields added later are zero when reading an older file
+    static size_t BinaryHeaderSize(uint32_t version) {
+        if (version == 1)
+            return offsetof(BinaryHeader, meshes);
+        if (version == 2)
+            return offsetof(BinaryHeader, instances);
+        return sizeof(BinaryHeader);
+    }
+
+    // Every mesh's vertices and indices are stored back to back in shared arrays
+    struct BinaryMesh {
+        uint64_t firstVertex;
+        uint64_t vertexCount;
+        uint64_t firstIndex;
+        uint64_t indexCount;
+        int32_t materialIndex;
+        uint32_t padding;
+    };
+
+    template <typename T>
+    static bool ReadArray(const MappedFile& file, const BinaryArray& array, std::vector<T>& out) {
+        size_t fileSize = file.GetSize();
+        if (array.count > fileSize / sizeof(T) || array.offset > fileSize - array.count * sizeof(T) || array.offset % alignof(T) != 0)
+            return false;
+
+        const T* begin = reinterpret_cast<const T*>(file.GetData() + array.offset);
+        out.assign(begin, begin + array.count);
+        return true;
+    }
+
+    bool LoadSceneBinary(const std::string& path, Scene& scene, CameraSettings& camera) {
+        MappedFile file(path);
+        if (!file.IsOpen()) {
+            std::cerr << "Failed to open scene " << path << "\n";
+            return false;
+        }
+
+        // Older versions have a shorter header, the fields they lack stay empty
+        BinaryHeader header{};
+        if (file.GetSize() < BinaryHeaderSize(1)) {
+            std::cerr << path << ": not a binary scene\n";
+            return false;
+        }
+        std::memcpy(static_cast<void*>(&header), file.GetData(), BinaryHeaderSize(1));
+        if (std::memcmp(header.magic, BinaryMagic, sizeof(BinaryMagic)) != 0 || header.version < 1 || header.version > BinaryVersion) {
+            std::cerr << path << ": not a binary scene or unsupported version\n";
+            return false;
+        }
+        size_t headerSize = BinaryHeaderSize(header.version);
+        if (file.GetSize() < headerSize) {
+            std::cerr << path << ": truncated or corrupt binary scene\n";
+            return false;
+        }
+        std::memcpy(static_cast<void*>(&header), file.GetData(), headerSize);
+
+        scene = Scene{};
+        scene.skyLight = header.skyLight;
+        camera = header.camera;
+        if (!ReadArray(file, header.materials, scene.materials) || !ReadArray(file, header.spheres, scene.spheres) ||
+            !ReadArray(file, header.directionalLights, scene.directionalLights) || !ReadArray(file, header.pointLights, scene.pointLights)) {
+            std::cerr << path << ": truncated or corrupt binary scene\n";
+            return false;
+        }
+        for (size_t i = 0; i < scene.spheres.size(); i++) {
+            if (!HasMaterial(scene, scene.spheres[i].materialIndex)) {
+                std::cerr << path << ": sphere " << i << " references material " << scene.spheres[i].materialIndex
+                          << ", the scene has " << scene.materials.size() << " materials\n";
+                return false;
+            }
+        }
+
+        std::vector<BinaryMesh> meshes;
+        std::vector<float> meshX, meshY, meshZ;
+        std::vector<uint32_t> meshIndices;
+        if (!ReadArray(file, header.meshes, meshes) || !ReadArray(file, header.meshX, meshX) || !ReadArray(file, header.meshY, meshY) ||
+            !ReadArray(file, header.meshZ, meshZ) || !ReadArray(file, header.meshIndices, meshIndices) || !ReadArray(file, header.instances, scene.instances) ||
+            meshX.size() != meshY.size() || meshX.size() != meshZ.size()) {
+            std::cerr << path << ": truncated or corrupt binary scene\n";
+            return false;
+        }
+        scene.meshes.resize(meshes.size());
+        for (size_t i = 0; i < meshes.size(); i++) {
+            const BinaryMesh& entry = meshes[i];
+            if (entry.firstVertex > meshX.size() || entry.vertexCount > meshX.size() - entry.firstVertex ||
+                entry.firstIndex > meshIndices.size() || entry.indexCount > meshIndices.size() - entry.firstIndex || entry.indexCount % 3 != 0) {
+                std::cerr << path << ": corrupt mesh " << i << " in binary scene\n";
+                return false;
+            }
+            Mesh& mesh = scene.meshes[i];
+            mesh.x.assign(meshX.begin() + entry.firstVertex, meshX.begin() + entry.firstVertex + entry.vertexCount);
+            mesh.y.assign(meshY.begin() + entry.firstVertex, meshY.begin() + entry.firstVertex + entry.vertexCount);
+            mesh.z.assign(meshZ.begin() + entry.firstVertex, meshZ.begin() + entry.firstVertex + entry.vertexCount);
+            mesh.indices.assign(meshIndices.begin() + entry.firstIndex, meshIndices.begin() + entry.firstIndex + entry.indexCount);
+            mesh.materialIndex = entry.materialIndex;
+            if (!HasMaterial(scene, mesh.materialIndex)) {
+                std::cerr << path << ": mesh " << i << " references material " << mesh.materialIndex
+                          << ", the scene has " << scene.materials.size() << " materials\n";
+                return false;
+            }
+            if (std::any_of(mesh.indices.begin(), mesh.indices.end(), [&](uint32_t index) { return index >= entry.vertexCount; })) {
+                std::cerr << path << ": corrupt mesh " << i << " in binary scene\n";
+                return false;
+            }
+        }
+        for (size_t i = 0; i < scene.instances.size(); i++) {
+            if (!IsValidInstance(scene, scene.instances[i])) {
+                std::cerr << path << ": instance " << i << " of mesh " << scene.instances[i].meshIndex << " with material "
+                          << scene.instances[i].materialIndex << ", the scene has " << scene.meshes.size() << " meshes and "
+                          << scene.materials.size() << " materials\n";
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool SaveSceneBinary(const std::string& path, const Scene& scene, const CameraSettings& camera) {
+        std::ofstream file(path, std::ios::binary);
+        if (!file) {
+            std::cerr << "Failed to create scene " << path << "\n";
+            return false;
+        }
+
+        auto align = [](uint64_t offset) { return (offset + BinaryAlignment - 1) / BinaryAlignment * BinaryAlignment; };
+
+        BinaryHeader header{};
+        std::memcpy(header.magic, BinaryMagic, sizeof(BinaryMagic));
+        header.version = BinaryVersion;
+        header.skyLight = scene.skyLight;
+        header.camera = camera;
+
+        uint64_t offset = align(sizeof(BinaryHeader));
+        auto place = [&](BinaryArray& array, uint64_t count, size_t elementSize) {
+            array.offset = offset;
+            array.count = count;
+            offset = align(offset + count * elementSize);
+        };
+        place(header.materials, scene.materials.size(), sizeof(Material));
+        place(header.spheres, scene.spheres.size(), sizeof(Sphere));
+        place(header.directionalLights, scene.directionalLights.size(), sizeof(DirectionalLight));
+        place(header.pointLights, scene.pointLights.size(), sizeof(PointLight));
+
+        std::vector<BinaryMesh> meshes(scene.meshes.size());
+        uint64_t vertexCount = 0;
+        uint64_t indexCount = 0;
+        for (size_t i = 0; i < scene.meshes.size(); i++) {
+            const Mesh& mesh = scene.meshes[i];
+            meshes[i] = BinaryMesh{vertexCount, mesh.x.size(), indexCount, mesh.indices.size(), mesh.materialIndex, 0};
+            vertexCount += mesh.x.size();
+            indexCount += mesh.indices.size();
+        }
+        place(header.meshes, meshes.size(), sizeof(BinaryMesh));
+        place(header.meshX, vertexCount, sizeof(float));
+        place(header.meshY, vertexCount, sizeof(float));
+        place(header.meshZ, vertexCount, sizeof(float));
+        place(header.meshIndices, indexCount, sizeof(uint32_t));
+        place(header.instances, scene.instances.size(), sizeof(Instance));
+
+        uint64_t written = 0;
+        auto write = [&](uint64_t at, const void* data, size_t size) {
+            static const char padding[BinaryAlignment] = {};
+            while (written < at) {
+                size_t padSize = static_cast<size_t>(std::min<uint64_t>(at - written, BinaryAlignment));
+                file.write(padding, padSize);
+                written += padSize;
+            }
+            file.write(static_cast<const char*>(data), size);
+            written += size;
+        };
+        write(0, &header, sizeof(header));
+        write(header.materials.offset, scene.materials.data(), scene.materials.size() * sizeof(Material));
+        write(header.spheres.offset, scene.spheres.data(), scene.spheres.size() * sizeof(Sphere));
+        write(header.directionalLights.offset, scene.directionalLights.data(), scene.directionalLights.size() * sizeof(DirectionalLight));
+        write(header.pointLights.offset, scene.pointLights.data(), scene.pointLights.size() * sizeof(PointLight));
+        write(header.meshes.offset, meshes.data(), meshes.size() * sizeof(BinaryMesh));
+        // Each axis of every mesh in turn, so a mesh's vertices are never copied into a temporary array
+        auto writeAxis = [&](const BinaryArray& array, std::vector<float> Mesh::*axis) {
+            write(array.offset, nullptr, 0);
+            for (const Mesh& mesh : scene.meshes)
+                write(written, (mesh.*axis).data(), (mesh.*axis).size() * sizeof(float));
+        };
+        writeAxis(header.meshX, &Mesh::x);
+        writeAxis(header.meshY, &Mesh::y);
+        writeAxis(header.meshZ, &Mesh::z);
+        write(header.meshIndices.offset, nullptr, 0);
+        for (const Mesh& mesh : scene.meshes)
+            write(written, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+        write(header.instances.offset, scene.instances.data(), scene.instances.size() * sizeof(Instance));
+
+        return static_cast<bool>(file);
+    }
+
+}
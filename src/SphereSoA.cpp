@@ -0,0 +1,214 @@
+#include <SphereSoA.h>
+#include <CpuFeatures.h>
+
+#include <cfloat>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define RT_X86 1
+    #include <immintrin.h>
+    #if defined(_MSC_VER)
+        #define RT_TARGET_AVX2
+    #else
+        #define RT_TARGET_AVX2 __attribute__((target("avx2")))
+    #endif
+#endif
+
+namespace RT {
+
+    void SphereSoA::Build(const std::vector<Core::Sphere>& spheres, const std::vector<uint32_t>& order) {
+        count = static_cast<uint32_t>(order.size());
+
+        // Pad so the widest kernel can always load a full register past the last slot, padded lanes are masked out
+        size_t paddedCount = (count + LaneCount - 1) / LaneCount * LaneCount + LaneCount;
+        x.assign(paddedCount, 0.0f);
+        y.assign(paddedCount, 0.0f);
+        z.assign(paddedCount, 0.0f);
+        radius.assign(paddedCount, 0.0f);
+        materialIndex.assign(paddedCount, 0);
+
+        sceneIndex = order;
+        slot.assign(spheres.size(), 0);
+        for (uint32_t i = 0; i < count; i++)
+            slot[order[i]] = i;
+        for (uint32_t i = 0; i < count; i++)
+            Update(order[i], spheres[order[i]]);
+    }
+
+    void SphereSoA::Update(uint32_t sceneIdx, const Core::Sphere& sphere) {
+        uint32_t i = slot[sceneIdx];
+        x[i] = sphere.position.x;
+        y[i] = sphere.position.y;
+        z[i] = sphere.position.z;
+        radius[i] = sphere.radius;
+        materialIndex[i] = sphere.materialIndex;
+    }
+
+    /*
+     *  (Cx - x)^2 + (Cy - y)^2 + (Cz - z)^2 = r^2, where C is the Circle position and r is the radius
+     *  From This equation, x, y, z, are the components of the ray, which results in the following
+     *  (Cx - (Ox + tDx))^2 + (Cy - (Oy + tDy))^2 + (Cz - (Oz + tDz))^2 = r^2 where O is the origin ray, D is the direction and t is scalar to solve for
+     *  For simplicity we can assume the circle is at the origin of the world, so the result is the following
+     *  (Ox + tDx) ^ 2 + (Oy + tDy) ^ 2 + (Oz + tDz)^2 = r^2
+     *  Ox^2 + 2OxtDx + t^2Dx^2 + Oy^2 + 2OytDy + t^2Dy^2 + Oz^2 + 2OztDz + t^2Dz^2 = r^2
+     *  t^2(Dx^2 + Dy^2 + Dz^2) + 2t(OxDx + OyDy + OzDz) + (Ox^2 + Oy^2 + Oz^2) = r^2
+     *
+     *  t^2 (D.D) + 2t(O.D) + (O.O) - r^2 = 0
+     *  Solve for t using quadratic formula
+    */
+    int IntersectSpheresScalar(const SphereSoA& spheres, uint32_t first, uint32_t count, const glm::vec3& org, const glm::vec3& dir, float& tmin) {
+        float a = glm::dot(dir, dir);
+        int hitSlot = -1;
+        for (uint32_t i = first; i < first + count; i++) {
+            // if the camera is moved somewhere offset the rendering as if the circle is at the origin of the camera
+            glm::vec3 origin = org - glm::vec3(spheres.x[i], spheres.y[i], spheres.z[i]);
+            float b = 2.0f * glm::dot(origin, dir);
+            float c = glm::dot(origin, origin) - spheres.radius[i] * spheres.radius[i];
+            float discriminant = b*b - 4*a*c;
+
+            // (-b +- sqrt(b^2 - 4ac))/2a
+            if (discriminant < 0)
+                continue;
+
+            float t0 = (-b - glm::sqrt(discriminant)) / (2.0f * a);
+            if (t0 < tmin && t0 >= 0) {
+                tmin = t0;
+                hitSlot = static_cast<int>(i);
+            }
+        }
+        return hitSlot;
+    }
+
+#ifdef RT_X86
+
+    // Same math as the scalar version, every lane keeps its own closest hit and the lanes are reduced at the end
+    static int IntersectSpheresSSE(const SphereSoA& spheres, uint32_t first, uint32_t count, const glm::vec3& org, const glm::vec3& dir, float& tmin) {
+        float a = glm::dot(dir, dir);
+        const __m128 ox = _mm_set1_ps(org.x), oy = _mm_set1_ps(org.y), oz = _mm_set1_ps(org.z);
+        const __m128 dx = _mm_set1_ps(dir.x), dy = _mm_set1_ps(dir.y), dz = _mm_set1_ps(dir.z);
+        const __m128 fourA = _mm_set1_ps(4 * a), twoA = _mm_set1_ps(2.0f * a), two = _mm_set1_ps(2.0f);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128i laneOffsets = _mm_setr_epi32(0, 1, 2, 3);
+        const __m128i end = _mm_set1_epi32(static_cast<int>(first + count));
+
+        __m128 bestT = _mm_set1_ps(tmin);
+        __m128i bestSlot = _mm_set1_epi32(-1);
+        for (uint32_t i = first; i < first + count; i += 4) {
+            __m128i slots = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(i)), laneOffsets);
+            __m128 cx = _mm_sub_ps(ox, _mm_loadu_ps(&spheres.x[i]));
+            __m128 cy = _mm_sub_ps(oy, _mm_loadu_ps(&spheres.y[i]));
+            __m128 cz = _mm_sub_ps(oz, _mm_loadu_ps(&spheres.z[i]));
+            __m128 r = _mm_loadu_ps(&spheres.radius[i]);
+
+            __m128 b = _mm_mul_ps(two, _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, dx), _mm_mul_ps(cy, dy)), _mm_mul_ps(cz, dz)));
+            __m128 c = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, cx), _mm_mul_ps(cy, cy)), _mm_mul_ps(cz, cz)), _mm_mul_ps(r, r));
+            __m128 discriminant = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(fourA, c));
+            __m128 t0 = _mm_div_ps(_mm_sub_ps(_mm_sub_ps(zero, b), _mm_sqrt_ps(_mm_max_ps(discriminant, zero))), twoA);
+
+            __m128 mask = _mm_cmpge_ps(discriminant, zero);
+            mask = _mm_and_ps(mask, _mm_cmpge_ps(t0, zero));
+            mask = _mm_and_ps(mask, _mm_cmplt_ps(t0, bestT));
+            mask = _mm_and_ps(mask, _mm_castsi128_ps(_mm_cmplt_epi32(slots, end)));
+
+            bestT = _mm_or_ps(_mm_and_ps(mask, t0), _mm_andnot_ps(mask, bestT));
+            __m128i maski = _mm_castps_si128(mask);
+            bestSlot = _mm_or_si128(_mm_and_si128(maski, slots), _mm_andnot_si128(maski, bestSlot));
+        }
+
+        alignas(16) float laneT[4];
+        alignas(16) int laneSlot[4];
+        _mm_store_ps(laneT, bestT);
+        _mm_store_si128(reinterpret_cast<__m128i*>(laneSlot), bestSlot);
+
+        int hitSlot = -1;
+        for (int lane = 0; lane < 4; lane++) {
+            if (laneSlot[lane] < 0)
+                continue;
+            if (laneT[lane] < tmin || (laneT[lane] == tmin && hitSlot >= 0 && laneSlot[lane] < hitSlot)) {
+                tmin = laneT[lane];
+                hitSlot = laneSlot[lane];
+            }
+        }
+        return hitSlot;
+    }
+
+    RT_TARGET_AVX2
+    static int IntersectSpheresAVX2(const SphereSoA& spheres, uint32_t first, uint32_t count, const glm::vec3& org, const glm::vec3& dir, float& tmin) {
+        float a = glm::dot(dir, dir);
+        const __m256 ox = _mm256_set1_ps(org.x), oy = _mm256_set1_ps(org.y), oz = _mm256_set1_ps(org.z);
+        const __m256 dx = _mm256_set1_ps(dir.x), dy = _mm256_set1_ps(dir.y), dz = _mm256_set1_ps(dir.z);
+        const __m256 fourA = _mm256_set1_ps(4 * a), twoA = _mm256_set1_ps(2.0f * a), two = _mm256_set1_ps(2.0f);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256i laneOffsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m256i end = _mm256_set1_epi32(static_cast<int>(first + count));
+
+        __m256 bestT = _mm256_set1_ps(tmin);
+        __m256i bestSlot = _mm256_set1_epi32(-1);
+        for (uint32_t i = first; i < first + count; i += 8) {
+            __m256i slots = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(i)), laneOffsets);
+            __m256 cx = _mm256_sub_ps(ox, _mm256_loadu_ps(&spheres.x[i]));
+            __m256 cy = _mm256_sub_ps(oy, _mm256_loadu_ps(&spheres.y[i]));
+            __m256 cz = _mm256_sub_ps(oz, _mm256_loadu_ps(&spheres.z[i]));
+            __m256 r = _mm256_loadu_ps(&spheres.radius[i]);
+
+            __m256 b = _mm256_mul_ps(two, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, dx), _mm256_mul_ps(cy, dy)), _mm256_mul_ps(cz, dz)));
+            __m256 c = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, cx), _mm256_mul_ps(cy, cy)), _mm256_mul_ps(cz, cz)), _mm256_mul_ps(r, r));
+            __m256 discriminant = _mm256_sub_ps(_mm256_mul_ps(b, b), _mm256_mul_ps(fourA, c));
+            __m256 t0 = _mm256_div_ps(_mm256_sub_ps(_mm256_sub_ps(zero, b), _mm256_sqrt_ps(_mm256_max_ps(discriminant, zero))), twoA);
+
+            __m256 mask = _mm256_cmp_ps(discriminant, zero, _CMP_GE_OQ);
+            mask = _mm256_and_ps(mask, _mm256_cmp_ps(t0, zero, _CMP_GE_OQ));
+            mask = _mm256_and_ps(mask, _mm256_cmp_ps(t0, bestT, _CMP_LT_OQ));
+            mask = _mm256_and_ps(mask, _mm256_castsi256_ps(_mm256_cmpgt_epi32(end, slots)));
+
+            bestT = _mm256_blendv_ps(bestT, t0, mask);
+            bestSlot = _mm256_blendv_epi8(bestSlot, slots, _mm256_castps_si256(mask));
+        }
+
+        alignas(32) float laneT[8];
+        alignas(32) int laneSlot[8];
+        _mm256_store_ps(laneT, bestT);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(laneSlot), bestSlot);
+
+        int hitSlot = -1;
+        for (int lane = 0; lane < 8; lane++) {
+            if (laneSlot[lane] < 0)
+                continue;
+            if (laneT[lane] < tmin || (laneT[lane] == tmin && hitSlot >= 0 && laneSlot[lane] < hitSlot)) {
+                tmin = laneT[lane];
+                hitSlot = laneSlot[lane];
+            }
+        }
+        return hitSlot;
+    }
+
+#endif
+
+    struct SphereKernel {
+        SphereIntersectFn fn;
+        const char* name;
+    };
+
+    static SphereKernel SelectSphereKernel() {
+    #ifdef RT_X86
+        if (CpuSupportsAVX2())
+            return { IntersectSpheresAVX2, "AVX2" };
+        return { IntersectSpheresSSE, "SSE" };
+    #else
+        return { IntersectSpheresScalar, "Scalar" };
+    #endif
+    }
+
+    static const SphereKernel& GetSphereKernel() {
+        static const SphereKernel kernel = SelectSphereKernel();
+        return kernel;
+    }
+
+    SphereIntersectFn GetSphereIntersectKernel() {
+        return GetSphereKernel().fn;
+    }
+
+    const char* GetSphereIntersectKernelName() {
+        return GetSphereKernel().name;
+    }
+
+}
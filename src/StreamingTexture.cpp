@@ -0,0 +1,151 @@
+#include <StreamingTexture.h>
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace RT {
+
+    StreamingTexture::~StreamingTexture() {
+        Release();
+    }
+
+    void StreamingTexture::Allocate(uint32_t width, uint32_t height) {
+        Release();
+        mWidth = width;
+        mHeight = height;
+        if (width == 0 || height == 0)
+            return;
+
+        // Immutable storage can't change size, a resize creates a new texture instead
+        glGenTextures(1, &mRendererID);
+        glBindTexture(GL_TEXTURE_2D, mRendererID);
+        if (GLAD_GL_VERSION_4_2)
+            glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+        else
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        GLsizeiptr size = static_cast<GLsizeiptr>(width) * height * 4;
+        mPersistent = GLAD_GL_VERSION_4_4;
+        glGenBuffers(RingSize, mBuffers);
+        for (uint32_t i = 0; i < RingSize; i++) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mBuffers[i]);
+            if (mPersistent) {
+                GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+                glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, flags);
+                mMapped[i] = static_cast<uint8_t*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags));
+            } else {
+                glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+            }
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    void StreamingTexture::Release() {
+        if (mBuffers[0]) {
+            for (uint32_t i = 0; i < RingSize; i++) {
+                if (mFences[i])
+                    glDeleteSync(static_cast<GLsync>(mFences[i]));
+                mFences[i] = nullptr;
+                if (mMapped[i]) {
+                    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mBuffers[i]);
+                    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+                    mMapped[i] = nullptr;
+                }
+            }
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            glDeleteBuffers(RingSize, mBuffers);
+            std::fill(std::begin(mBuffers), std::end(mBuffers), 0u);
+        }
+        if (mRendererID)
+            glDeleteTextures(1, &mRendererID);
+        mRendererID = 0;
+        mWidth = 0;
+        mHeight = 0;
+        mRingIndex = 0;
+    }
+
+    void StreamingTexture::Upload(const Core::Image& image, const std::vector<Core::ImageRegion>& regions) {
+        std::vector<Core::ImageRegion> uploads;
+        if (image.width != mWidth || image.height != mHeight) {
+            Allocate(image.width, image.height);
+            uploads.push_back({0, 0, image.width, image.height});
+        } else if (!regions.empty()) {
+            // Thousands of small uploads cost more in driver overhead than a few extra pixels, so regions that mostly
+            // cover their bounding box go up as that box in a single call
+            Core::ImageRegion bounds = regions[0];
+            uint64_t area = 0;
+            for (const Core::ImageRegion& region : regions) {
+                uint32_t x1 = std::max(bounds.x + bounds.width, region.x + region.width);
+                uint32_t y1 = std::max(bounds.y + bounds.height, region.y + region.height);
+                bounds.x = std::min(bounds.x, region.x);
+                bounds.y = std::min(bounds.y, region.y);
+                bounds.width = x1 - bounds.x;
+                bounds.height = y1 - bounds.y;
+                area += static_cast<uint64_t>(region.width) * region.height;
+            }
+            if (area * 2 >= static_cast<uint64_t>(bounds.width) * bounds.height)
+                uploads.push_back(bounds);
+            else
+                uploads = regions;
+        }
+        if (uploads.empty() || mRendererID == 0)
+            return;
+
+        uint32_t slot = mRingIndex;
+        mRingIndex = (mRingIndex + 1) % RingSize;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mBuffers[slot]);
+
+        uint8_t* mapped = nullptr;
+        GLsizeiptr size = static_cast<GLsizeiptr>(mWidth) * mHeight * 4;
+        if (mPersistent) {
+            // The buffer was last read RingSize uploads ago, so this normally returns right away
+            if (mFences[slot]) {
+                GLsync fence = static_cast<GLsync>(mFences[slot]);
+                if (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_WAIT_FAILED)
+                    std::cerr << "Failed to wait for a pixel buffer upload\n";
+                glDeleteSync(fence);
+                mFences[slot] = nullptr;
+            }
+            mapped = mMapped[slot];
+        } else {
+            // Invalidating lets the driver hand out fresh memory instead of waiting for the previous upload
+            mapped = static_cast<uint8_t*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+        }
+        if (!mapped) {
+            std::cerr << "Failed to map the pixel buffer\n";
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            return;
+        }
+
+        // The buffer mirrors the image layout, so every region sits at the same offset in both
+        for (const Core::ImageRegion& region : uploads) {
+            size_t rowBytes = static_cast<size_t>(region.width) * 4;
+            for (uint32_t y = region.y; y < region.y + region.height; y++) {
+                size_t offset = (static_cast<size_t>(y) * mWidth + region.x) * 4;
+                std::memcpy(mapped + offset, image.pixels.data() + offset, rowBytes);
+            }
+        }
+        if (!mPersistent)
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+        glBindTexture(GL_TEXTURE_2D, mRendererID);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, static_cast<GLint>(mWidth));
+        for (const Core::ImageRegion& region : uploads) {
+            size_t offset = (static_cast<size_t>(region.y) * mWidth + region.x) * 4;
+            glTexSubImage2D(GL_TEXTURE_2D, 0, region.x, region.y, region.width, region.height, GL_RGBA, GL_UNSIGNED_BYTE,
+                            reinterpret_cast<const void*>(offset));
+        }
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        if (mPersistent)
+            mFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+}
@@ -0,0 +1,120 @@
+#include <ThreadPool.h>
+
+#include <algorithm>
+
+namespace RT {
+
+    ThreadPool::ThreadPool(uint32_t threadCount) {
+        SetThreadCount(threadCount);
+    }
+
+    ThreadPool::~ThreadPool() {
+        StopWorkers();
+    }
+
+    void ThreadPool::SetThreadCount(uint32_t threadCount) {
+        if (threadCount == 0)
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        if (threadCount == mWorkers.size())
+            return;
+
+        StopWorkers();
+        mWorkers.clear();
+        for (uint32_t i = 0; i < threadCount; i++)
+            mWorkers.push_back(std::make_unique<Worker>());
+
+        mStop = false;
+        for (uint32_t i = 1; i < threadCount; i++)
+            mThreads.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+
+    void ThreadPool::ParallelFor(uint32_t taskCount, const std::function<void(uint32_t, uint32_t)>& task) {
+        if (taskCount == 0)
+            return;
+
+        mJob = &task;
+        mPending = taskCount;
+
+        uint32_t workerCount = GetThreadCount();
+        for (uint32_t w = 0; w < workerCount; w++) {
+            uint32_t begin = static_cast<uint32_t>(static_cast<uint64_t>(taskCount) * w / workerCount);
+            uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(taskCount) * (w + 1) / workerCount);
+            std::lock_guard<std::mutex> lock(mWorkers[w]->mutex);
+            for (uint32_t i = begin; i < end; i++)
+                mWorkers[w]->tasks.push_back(i);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mJobMutex);
+            mGeneration++;
+        }
+        mWakeCondition.notify_all();
+
+        RunTasks(0);
+
+        std::unique_lock<std::mutex> lock(mJobMutex);
+        mDoneCondition.wait(lock, [this] { return mPending == 0; });
+        mJob = nullptr;
+    }
+
+    void ThreadPool::WorkerLoop(uint32_t threadIndex) {
+        uint64_t seenGeneration = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mJobMutex);
+                mWakeCondition.wait(lock, [&] { return mStop || mGeneration != seenGeneration; });
+                if (mStop)
+                    return;
+                seenGeneration = mGeneration;
+            }
+            RunTasks(threadIndex);
+        }
+    }
+
+    void ThreadPool::RunTasks(uint32_t threadIndex) {
+        uint32_t task;
+        while (PopTask(threadIndex, task) || StealTask(threadIndex, task)) {
+            (*mJob)(task, threadIndex);
+            if (mPending.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> lock(mJobMutex);
+                mDoneCondition.notify_all();
+            }
+        }
+    }
+
+    bool ThreadPool::PopTask(uint32_t threadIndex, uint32_t& task) {
+        Worker& worker = *mWorkers[threadIndex];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (worker.tasks.empty())
+            return false;
+        task = worker.tasks.front();
+        worker.tasks.pop_front();
+        return true;
+    }
+
+    bool ThreadPool::StealTask(uint32_t threadIndex, uint32_t& task) {
+        uint32_t workerCount = GetThreadCount();
+        for (uint32_t i = 1; i < workerCount; i++) {
+            Worker& victim = *mWorkers[(threadIndex + i) % workerCount];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.tasks.empty())
+                continue;
+            task = victim.tasks.back();
+            victim.tasks.pop_back();
+            return true;
+        }
+        return false;
+    }
+
+    void ThreadPool::StopWorkers() {
+        {
+            std::lock_guard<std::mutex> lock(mJobMutex);
+            mStop = true;
+        }
+        mWakeCondition.notify_all();
+        for (std::thread& thread : mThreads)
+            thread.join();
+        mThreads.clear();
+    }
+
+}
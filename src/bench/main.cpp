@@ -0,0 +1,532 @@
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <functional>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+
+#include <Renderer.h>
+#include <Camera.h>
+#include <Scene.h>
+#include <PostProcess.h>
+#include <Denoiser.h>
+#include <Image.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#define LOG(x, ...) printf(x, ##__VA_ARGS__)
+
+// Benchmarks the tracer's hot paths on a fixed set of scenes, writes the results as JSON and compares them to a baseline
+struct Options {
+    std::string output = "bench.json";
+    std::string baseline;
+    std::string filter;         // Only run benchmarks whose name contains this
+    float tolerance = 0.05f;    // Slowdown relative to the baseline that counts as a regression
+    uint32_t width = 640;
+    uint32_t height = 360;
+    uint32_t repeats = 5;
+    uint32_t threads = 0;
+    bool skipLarge = false;
+};
+
+struct Result {
+    std::string name;
+    std::string unit;
+    double value = 0.0;
+    bool higherIsBetter = true;
+};
+
+// Reaches into the private hot paths so they can be timed in isolation
+namespace RT {
+    struct RendererBenchmark {
+        static uint64_t IntersectRays(Renderer& renderer, const std::vector<Ray>& rays) {
+            uint64_t hits = 0;
+            for (const Ray& ray : rays)
+                hits += renderer.RayIntersectionTest(ray).objIdx >= 0;
+            return hits;
+        }
+
+        static glm::vec3 TracePaths(Renderer& renderer, const std::vector<Ray>& rays) {
+            glm::vec3 sum(0);
+            for (size_t i = 0; i < rays.size(); i++) {
+                SamplerState sampler = renderer.mSampler.Start(static_cast<uint32_t>(i), 0, 0, 0);
+                FirstHit firstHit;
+                sum += renderer.TraceRay(rays[i], sampler, firstHit);
+            }
+            return sum;
+        }
+    };
+}
+
+namespace Core {
+    struct CameraBenchmark {
+        static void CalculateRayDirections(Camera& camera) { camera.CalculateRayDirections(); }
+    };
+}
+
+struct BenchScene {
+    std::string name;
+    Core::Scene scene;
+    glm::vec3 cameraPosition{0, 0, 3};
+};
+
+static uint32_t NextRandom(uint32_t& state) {
+    state = state * 747796405u + 2891336453u;
+    uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+static float RandomFloat(uint32_t& state, float min, float max) {
+    return min + (max - min) * (NextRandom(state) / 4294967295.0f);
+}
+
+// Random spheres filling a cube in front of the camera, fixed seed so every run traces the same scene
+static Core::Scene CreateRandomScene(uint32_t sphereCount, float extent, float minRadius, float maxRadius, float emissiveFraction) {
+    Core::Scene scene;
+    uint32_t seed = 1234;
+    for (int i = 0; i < 8; i++) {
+        Core::Material mat;
+        mat.albedo = {RandomFloat(seed, 0.1f, 1.0f), RandomFloat(seed, 0.1f, 1.0f), RandomFloat(seed, 0.1f, 1.0f)};
+        mat.shininess = RandomFloat(seed, 0.0f, 1.0f);
+        scene.materials.push_back(mat);
+    }
+    Core::Material emissive;
+    emissive.emissionColor = glm::vec3(1.0f, 0.9f, 0.7f);
+    emissive.emissionStrength = 10.0f;
+    scene.materials.push_back(emissive);
+
+    scene.spheres.reserve(sphereCount);
+    for (uint32_t i = 0; i < sphereCount; i++) {
+        Core::Sphere sphere;
+        sphere.position = {RandomFloat(seed, -extent, extent), RandomFloat(seed, -extent, extent), RandomFloat(seed, -extent, extent)};
+        sphere.radius = RandomFloat(seed, minRadius, maxRadius);
+        bool isEmissive = RandomFloat(seed, 0.0f, 1.0f) < emissiveFraction;
+        sphere.materialIndex = isEmissive ? 8 : static_cast<int>(NextRandom(seed) % 8);
+        scene.spheres.push_back(sphere);
+    }
+    return scene;
+}
+
+// Rolling terrain of resolution x resolution quads under the default spheres, exercises the triangle BVH
+static Core::Scene CreateMeshScene(uint32_t resolution, float extent) {
+    Core::Scene scene = Core::CreateDefaultScene();
+    Core::Mesh terrain;
+    for (uint32_t j = 0; j <= resolution; j++) {
+        for (uint32_t i = 0; i <= resolution; i++) {
+            float u = static_cast<float>(i) / resolution * 2.0f - 1.0f;
+            float v = static_cast<float>(j) / resolution * 2.0f - 1.0f;
+            float height = 0.5f * std::sin(u * 9.0f) * std::cos(v * 7.0f) - 2.0f;
+            terrain.AddVertex({u * extent, height, v * extent});
+        }
+    }
+    for (uint32_t j = 0; j < resolution; j++) {
+        for (uint32_t i = 0; i < resolution; i++) {
+            uint32_t a = j * (resolution + 1) + i;
+            uint32_t c = a + resolution + 1;
+            terrain.indices.insert(terrain.indices.end(), {a, a + 1, c + 1, a, c + 1, c});
+        }
+    }
+    terrain.materialIndex = 0;
+    scene.meshes.push_back(std::move(terrain));
+    return scene;
+}
+
+// Low poly tree, a cone on a square trunk standing on the origin
+static Core::Mesh CreateTreeMesh() {
+    constexpr uint32_t Segments = 8;
+    Core::Mesh tree;
+    for (int i = 0; i < 4; i++) {
+        float x = (i == 1 || i == 2) ? 0.1f : -0.1f;
+        float z = i >= 2 ? 0.1f : -0.1f;
+        tree.AddVertex({x, 0.0f, z});
+        tree.AddVertex({x, 0.6f, z});
+    }
+    for (uint32_t i = 0; i < 4; i++) {
+        uint32_t a = 2 * i, b = 2 * ((i + 1) % 4);
+        tree.indices.insert(tree.indices.end(), {a, b, b + 1, a, b + 1, a + 1});
+    }
+
+    uint32_t tip = tree.GetVertexCount();
+    tree.AddVertex({0.0f, 2.0f, 0.0f});
+    for (uint32_t i = 0; i < Segments; i++) {
+        float angle = 2.0f * glm::pi<float>() * i / Segments;
+        tree.AddVertex({0.6f * std::cos(angle), 0.5f, 0.6f * std::sin(angle)});
+    }
+    for (uint32_t i = 0; i < Segments; i++)
+        tree.indices.insert(tree.indices.end(), {tip, tip + 1 + i, tip + 1 + (i + 1) % Segments});
+    return tree;
+}
+
+// side x side trees on a jittered grid with random rotation and size, all instances of one mesh
+static Core::Scene CreateForestScene(uint32_t side) {
+    Core::Scene scene = Core::CreateDefaultScene();
+    scene.spheres.clear();
+    scene.meshes.push_back(CreateTreeMesh());
+    scene.meshes.back().materialIndex = 0;
+
+    uint32_t seed = 4321;
+    scene.instances.reserve(static_cast<size_t>(side) * side);
+    for (uint32_t j = 0; j < side; j++) {
+        for (uint32_t i = 0; i < side; i++) {
+            glm::vec3 position(2.0f * (i + RandomFloat(seed, -0.3f, 0.3f)) - side, -1.0f, -2.0f * (j + RandomFloat(seed, -0.3f, 0.3f)));
+            glm::mat4 transform = glm::translate(glm::mat4(1.0f), position);
+            transform = glm::rotate(transform, RandomFloat(seed, 0.0f, 2.0f * glm::pi<float>()), glm::vec3(0, 1, 0));
+            transform = glm::scale(transform, glm::vec3(RandomFloat(seed, 0.7f, 1.3f)));
+            Core::Instance instance;
+            instance.transform = transform;
+            instance.materialIndex = (i + j) % 3 == 0 ? 2 : -1;
+            scene.instances.push_back(instance);
+        }
+    }
+    return scene;
+}
+
+static std::vector<BenchScene> CreateScenes(bool skipLarge) {
+    std::vector<BenchScene> scenes;
+    scenes.push_back({"few", Core::CreateDefaultScene(), {0, 0, 3}});
+    scenes.push_back({"10k", CreateRandomScene(10000, 20.0f, 0.1f, 0.6f, 0.0f), {0, 0, 45}});
+    if (!skipLarge)
+        scenes.push_back({"1m", CreateRandomScene(1000000, 100.0f, 0.05f, 0.3f, 0.0f), {0, 0, 200}});
+
+    // Dim sky so most light comes from the spheres
+    BenchScene emissive{"emissive", CreateRandomScene(2000, 10.0f, 0.2f, 1.0f, 0.5f), {0, 0, 25}};
+    emissive.scene.skyLight.strength = 0.05f;
+    scenes.push_back(std::move(emissive));
+
+    scenes.push_back({"mesh", CreateMeshScene(skipLarge ? 128 : 512, 20.0f), {0, 0, 6}});
+    scenes.push_back({"forest", CreateForestScene(skipLarge ? 100 : 1000), {0, 1, 4}});
+    return scenes;
+}
+
+// Runs fn repeats times and returns the median time in milliseconds
+static double MedianTime(uint32_t repeats, const std::function<void()>& fn) {
+    std::vector<double> times;
+    for (uint32_t i = 0; i < repeats; i++) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+static bool Selected(const Options& options, const std::string& name) {
+    return options.filter.empty() || name.find(options.filter) != std::string::npos;
+}
+
+static void RunSceneBenchmarks(const Options& options, const BenchScene& bench, std::vector<Result>& results) {
+    Core::Camera camera(bench.cameraPosition, glm::vec2(1), 45.0f, 0.1f, 1000.0f);
+    camera.OnResize({static_cast<float>(options.width), static_cast<float>(options.height)});
+
+    auto buildStart = std::chrono::steady_clock::now();
+    RT::Renderer renderer(bench.scene);
+    double buildTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart).count();
+    renderer.SetThreadCount(options.threads);
+    renderer.OnResize(options.width, options.height);
+
+    std::vector<RT::Ray> rays;
+    rays.reserve(static_cast<size_t>(options.width) * options.height);
+    for (uint32_t y = 0; y < options.height; y++) {
+        for (uint32_t x = 0; x < options.width; x++)
+            rays.push_back({camera.GetPosition(), camera.GetRayDirection(static_cast<float>(x), static_cast<float>(y))});
+    }
+
+    std::string name = "build/" + bench.name;
+    if (Selected(options, name)) {
+        results.push_back({name, "ms", buildTime, false});
+        uint64_t triangleCount = 0;
+        for (const Core::Mesh& mesh : bench.scene.meshes)
+            triangleCount += mesh.GetTriangleCount();
+        LOG("%-22s %10.2f ms (%zu spheres, %llu triangles, %zu instances)\n", name.c_str(), buildTime, bench.scene.spheres.size(),
+            static_cast<unsigned long long>(triangleCount), bench.scene.instances.size());
+    }
+
+    name = "intersect/" + bench.name;
+    if (Selected(options, name)) {
+        uint64_t hits = 0;
+        double time = MedianTime(options.repeats, [&]() { hits += RT::RendererBenchmark::IntersectRays(renderer, rays); });
+        results.push_back({name, "Mrays/s", rays.size() / (time * 1e3), true});
+        LOG("%-22s %10.2f Mrays/s (%llu hits)\n", name.c_str(), results.back().value, static_cast<unsigned long long>(hits));
+    }
+
+    name = "trace/" + bench.name;
+    if (Selected(options, name)) {
+        glm::vec3 sum(0);
+        double time = MedianTime(options.repeats, [&]() { sum += RT::RendererBenchmark::TracePaths(renderer, rays); });
+        results.push_back({name, "Mpaths/s", rays.size() / (time * 1e3), true});
+        LOG("%-22s %10.2f Mpaths/s (checksum %.3f)\n", name.c_str(), results.back().value, sum.x + sum.y + sum.z);
+    }
+
+    name = "render/" + bench.name;
+    if (Selected(options, name)) {
+        std::unique_ptr<Core::Image> image = std::make_unique<Core::Image>(options.width, options.height, 4);
+        uint32_t frame = 1;
+        double time = MedianTime(options.repeats, [&]() { renderer.Render(camera, image.get(), frame++); });
+        results.push_back({name, "ms", time, false});
+        LOG("%-22s %10.2f ms/frame at %ux%u, %u threads\n", name.c_str(), time, options.width, options.height, renderer.GetThreadCount());
+    }
+}
+
+static void RunCameraBenchmarks(const Options& options, std::vector<Result>& results) {
+    std::string name = "camera/raydirs-1080p";
+    if (Selected(options, name)) {
+        Core::Camera camera(glm::vec3(0, 0, 3), glm::vec2(1), 45.0f, 0.1f, 1000.0f);
+        camera.SetRayGeneration(Core::Camera::RayGeneration::Cached);
+        camera.OnResize({1920.0f, 1080.0f});
+        double time = MedianTime(options.repeats, [&]() { Core::CameraBenchmark::CalculateRayDirections(camera); });
+        results.push_back({name, "ms", time, false});
+        LOG("%-22s %10.2f ms\n", name.c_str(), time);
+    }
+
+    // The same directions built on the fly, as the renderer does with an Analytic camera
+    name = "camera/analytic-1080p";
+    if (Selected(options, name)) {
+        Core::Camera camera(glm::vec3(0, 0, 3), glm::vec2(1), 45.0f, 0.1f, 1000.0f);
+        camera.OnResize({1920.0f, 1080.0f});
+        glm::vec3 sum(0);
+        double time = MedianTime(options.repeats, [&]() {
+            for (uint32_t y = 0; y < 1080; y++) {
+                for (uint32_t x = 0; x < 1920; x++)
+                    sum += camera.GetRayDirection(static_cast<float>(x), static_cast<float>(y));
+            }
+        });
+        results.push_back({name, "ms", time, false});
+        LOG("%-22s %10.2f ms (checksum %.3f)\n", name.c_str(), time, sum.x + sum.y + sum.z);
+    }
+}
+
+static void RunPostProcessBenchmarks(const Options& options, std::vector<Result>& results) {
+    const uint32_t pixelCount = 1920 * 1080;
+    std::vector<float> r(pixelCount), g(pixelCount), b(pixelCount);
+    uint32_t state = 1;
+    for (uint32_t i = 0; i < pixelCount; i++) {
+        state = state * 747796405u + 2891336453u;
+        r[i] = static_cast<float>(state >> 8) / 16777216.0f * 4.0f;
+        g[i] = r[i] * 0.5f;
+        b[i] = r[i] * 0.25f;
+    }
+    std::vector<uint8_t> pixels(pixelCount * 4);
+    RT::DisplayTransform transform;
+
+    struct Kernel {
+        std::string name;
+        RT::PostProcessFn fn;
+    };
+    Kernel kernels[] = {
+        { "postprocess/scalar-1080p", RT::PostProcessScalar },
+        { "postprocess/simd-1080p", RT::GetPostProcessKernel() },
+    };
+    for (const Kernel& kernel : kernels) {
+        if (!Selected(options, kernel.name))
+            continue;
+        double time = MedianTime(options.repeats, [&]() { kernel.fn(r.data(), g.data(), b.data(), pixelCount, transform, pixels.data()); });
+        results.push_back({kernel.name, "ms", time, false});
+        LOG("%-22s %10.2f ms (%s)\n", kernel.name.c_str(), time, kernel.fn == RT::PostProcessScalar ? "Scalar" : RT::GetPostProcessKernelName());
+    }
+}
+
+// Noisy color over a few flat planes at different depths, which keeps the edge stopping weights busy everywhere
+static void RunDenoiserBenchmarks(const Options& options, std::vector<Result>& results) {
+    std::string name = "denoise/atrous-1080p";
+    if (!Selected(options, name))
+        return;
+
+    const uint32_t width = 1920, height = 1080;
+    RT::GBuffer gbuffer;
+    gbuffer.Resize(width * height);
+    RT::Denoiser denoiser;
+    denoiser.Resize(width, height);
+    uint32_t state = 1;
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            uint32_t pixelIndex = x + y * width;
+            uint32_t plane = (x / 300 + y / 200) % 3;
+            RT::FirstHit hit;
+            hit.albedo = glm::vec3(0.2f + 0.3f * plane, 0.5f, 0.8f - 0.2f * plane);
+            hit.normal = plane == 0 ? glm::vec3(0, 1, 0) : glm::vec3(0, 0, 1);
+            hit.depth = 2.0f + plane + 0.001f * y;
+            gbuffer.AddSample(pixelIndex, hit, 1);
+            state = state * 747796405u + 2891336453u;
+            float noise = static_cast<float>(state >> 8) / 16777216.0f * 2.0f;
+            denoiser.SetPixel(pixelIndex, hit.albedo * noise, -1.0f, hit.albedo);
+        }
+    }
+
+    RT::ThreadPool threadPool(options.threads);
+    RT::DenoiserSettings settings;
+    double time = MedianTime(options.repeats, [&]() { denoiser.Denoise(gbuffer, settings, threadPool); });
+    results.push_back({name, "ms", time, false});
+    LOG("%-22s %10.2f ms (%s, %u threads)\n", name.c_str(), time, RT::Denoiser::GetKernelName(), threadPool.GetThreadCount());
+}
+
+// One result per line so the baseline can be read back without a JSON library
+static bool WriteResults(const std::string& path, const Options& options, const std::vector<Result>& results) {
+    std::ofstream file(path);
+    if (!file) {
+        LOG("Failed to create %s\n", path.c_str());
+        return false;
+    }
+
+    file << "{\n  \"width\": " << options.width << ",\n  \"height\": " << options.height << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& result = results[i];
+        file << "    {\"name\": \"" << result.name << "\", \"unit\": \"" << result.unit << "\", \"value\": " << result.value
+             << ", \"higherIsBetter\": " << (result.higherIsBetter ? "true" : "false") << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    file << "  ]\n}\n";
+    return static_cast<bool>(file);
+}
+
+static bool ReadField(const std::string& line, const std::string& key, std::string& value) {
+    std::string pattern = "\"" + key + "\": ";
+    size_t start = line.find(pattern);
+    if (start == std::string::npos)
+        return false;
+    start += pattern.size();
+
+    if (line[start] == '"') {
+        size_t end = line.find('"', start + 1);
+        if (end == std::string::npos)
+            return false;
+        value = line.substr(start + 1, end - start - 1);
+    } else {
+        size_t end = line.find_first_of(",}", start);
+        value = line.substr(start, end - start);
+    }
+    return true;
+}
+
+static bool ReadResults(const std::string& path, std::vector<Result>& results) {
+    std::ifstream file(path);
+    if (!file) {
+        LOG("Failed to open baseline %s\n", path.c_str());
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        Result result;
+        std::string value, higherIsBetter;
+        if (!ReadField(line, "name", result.name) || !ReadField(line, "value", value))
+            continue;
+        ReadField(line, "unit", result.unit);
+        ReadField(line, "higherIsBetter", higherIsBetter);
+        result.value = std::strtod(value.c_str(), nullptr);
+        result.higherIsBetter = higherIsBetter == "true";
+        results.push_back(result);
+    }
+    return true;
+}
+
+// Returns the number of benchmarks that got slower than the tolerance allows
+static uint32_t CompareResults(const std::vector<Result>& baseline, const std::vector<Result>& results, float tolerance) {
+    uint32_t regressions = 0;
+    LOG("\n%-22s %12s %12s %9s\n", "benchmark", "baseline", "current", "change");
+    for (const Result& result : results) {
+        auto it = std::find_if(baseline.begin(), baseline.end(), [&](const Result& base) { return base.name == result.name; });
+        if (it == baseline.end() || it->value == 0.0) {
+            LOG("%-22s %12s %12.3f %9s\n", result.name.c_str(), "-", result.value, "new");
+            continue;
+        }
+
+        // Positive change is always an improvement, no matter which direction the unit goes
+        double change = result.higherIsBetter ? result.value / it->value - 1.0 : it->value / result.value - 1.0;
+        bool regressed = change < -tolerance;
+        regressions += regressed;
+        LOG("%-22s %12.3f %12.3f %+8.1f%%%s\n", result.name.c_str(), it->value, result.value, change * 100.0, regressed ? "  REGRESSION" : "");
+    }
+    return regressions;
+}
+
+static void PrintUsage(const char* exe) {
+    LOG("Usage: %s [options]\n", exe);
+    LOG("  --output <path>     Results JSON (default bench.json)\n");
+    LOG("  --baseline <path>   Compare against earlier results, exits with 1 on a regression\n");
+    LOG("  --tolerance <f>     Allowed slowdown before a result counts as a regression (default 0.05)\n");
+    LOG("  --filter <text>     Only run benchmarks whose name contains text\n");
+    LOG("  --width <px>        Render resolution (default 640)\n");
+    LOG("  --height <px>       Render resolution (default 360)\n");
+    LOG("  --repeats <n>       Runs per benchmark, the median is reported (default 5)\n");
+    LOG("  --threads <n>       Render threads, 0 uses every hardware thread (default 0)\n");
+    LOG("  --skip-large        Skip the 1M sphere scene\n");
+}
+
+static bool ParseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h")
+            return false;
+        if (arg == "--skip-large") {
+            options.skipLarge = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            LOG("Missing value for %s\n", arg.c_str());
+            return false;
+        }
+
+        const char* value = argv[++i];
+        if (arg == "--output") {
+            options.output = value;
+        } else if (arg == "--baseline") {
+            options.baseline = value;
+        } else if (arg == "--tolerance") {
+            options.tolerance = std::strtof(value, nullptr);
+        } else if (arg == "--filter") {
+            options.filter = value;
+        } else if (arg == "--width") {
+            options.width = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--height") {
+            options.height = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--repeats") {
+            options.repeats = std::max(1u, static_cast<uint32_t>(std::strtoul(value, nullptr, 10)));
+        } else if (arg == "--threads") {
+            options.threads = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        } else {
+            LOG("Unknown option %s\n", arg.c_str());
+            return false;
+        }
+    }
+
+    if (options.width == 0 || options.height == 0) {
+        LOG("Image size must not be zero\n");
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage(argv[0]);
+        return -1;
+    }
+
+    std::vector<Result> results;
+    RunCameraBenchmarks(options, results);
+    RunPostProcessBenchmarks(options, results);
+    RunDenoiserBenchmarks(options, results);
+    for (const BenchScene& scene : CreateScenes(options.skipLarge))
+        RunSceneBenchmarks(options, scene, results);
+
+    if (!WriteResults(options.output, options, results))
+        return -1;
+    LOG("Saved %s\n", options.output.c_str());
+
+    if (!options.baseline.empty()) {
+        std::vector<Result> baseline;
+        if (!ReadResults(options.baseline, baseline))
+            return -1;
+        uint32_t regressions = CompareResults(baseline, results, options.tolerance);
+        if (regressions > 0) {
+            LOG("%u benchmark(s) regressed by more than %.1f%%\n", regressions, options.tolerance * 100.0f);
+            return 1;
+        }
+    }
+    return 0;
+}
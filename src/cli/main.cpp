@@ -0,0 +1,313 @@
+#include <algorithm>
+#include <string>
+#include <memory>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+
+#include <Renderer.h>
+#include <Camera.h>
+#include <Scene.h>
+#include <Image.h>
+#include <ImageFile.h>
+#include <SceneFile.h>
+
+#include <glm/glm.hpp>
+
+#define LOG(x, ...) printf(x, ##__VA_ARGS__)
+
+// Renders a scene without a window or OpenGL context, meant for render farm nodes
+struct Options {
+    std::string scene;          // Empty renders the default scene
+    std::string saveScene;      // Convert the scene to this path and exit, the extension picks the format
+    uint32_t width = 1920;
+    uint32_t height = 1080;
+    uint32_t samples = 0;       // Stop after this many samples per pixel on average, 0 for no limit
+    float timeBudget = 0.0f;    // Stop after this many seconds, 0 for no limit
+    float noiseThreshold = 0.0f;    // Enables adaptive sampling and stops once the image converged, 0 to disable
+    float convergence = 0.999f;
+    int bounces = 8;
+    int rouletteDepth = 3;      // Russian roulette starts after this many bounces, negative disables it
+    bool sampleLights = true;
+    bool denoise = false;
+    uint32_t threads = 0;
+    RT::Integrator integrator = RT::Integrator::Megakernel;
+    RT::AccumulationPrecision accumulation = RT::AccumulationPrecision::Float;
+    RT::SamplerType sampler = RT::SamplerType::Sobol;
+    RT::ToneMapper toneMapper = RT::ToneMapper::Uncharted2;
+    std::string output = "output";
+    Core::Camera::RayGeneration rayGeneration = Core::Camera::RayGeneration::Analytic;
+    std::string trace;          // Chrome trace of every rendered tile, empty to skip
+};
+
+static void PrintUsage(const char* exe) {
+    LOG("Usage: %s [options]\n", exe);
+    LOG("  --scene <path>      Scene to render, .rtscene text or .rtsb binary (default scene if omitted)\n");
+    LOG("  --save-scene <path> Write the scene to path and exit, use .rtsb to convert to the binary format\n");
+    LOG("  --width <px>        Image width (default 1920)\n");
+    LOG("  --height <px>       Image height (default 1080)\n");
+    LOG("  --samples <n>       Samples per pixel to render, on average with --noise, which moves them to noisy pixels\n");
+    LOG("  --time <seconds>    Stop once this much time was spent rendering\n");
+    LOG("  --noise <error>     Adaptive sampling, stop sampling pixels below this relative error and finish once converged\n");
+    LOG("  --convergence <f>   Fraction of pixels that have to converge to finish (default 0.999)\n");
+    LOG("  --bounces <n>       Max bounces per path (default 8)\n");
+    LOG("  --roulette <n|off>  Russian roulette after n bounces, or off to always trace every bounce (default 3)\n");
+    LOG("  --light-sampling <on|off> Shadow rays towards lights at every diffuse hit (default on)\n");
+    LOG("  --denoise <on|off>  Filter the final image guided by the first hits, for few samples per pixel (default off)\n");
+    LOG("  --threads <n>       Render threads, 0 uses every hardware thread (default 0)\n");
+    LOG("  --integrator <name> megakernel or wavefront (default megakernel)\n");
+    LOG("  --accumulation <p>  half, float or double precision for the accumulated image (default float)\n");
+    LOG("  --sampler <name>    sobol, bluenoise or pcg random numbers (default sobol)\n");
+    LOG("  --tonemapper <name> uncharted2, aces or reinhard (default uncharted2)\n");
+    LOG("  --output <path>     Output PNG path, .png is appended (default output)\n");
+    LOG("  --camera-rays <m>   analytic (jittered) or cached primary rays (default analytic)\n");
+    LOG("  --trace <path>      Write a Chrome trace JSON of the render\n");
+    LOG("Without --samples, --time or --noise, 64 samples per pixel are rendered.\n");
+}
+
+static bool ParseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            return false;
+        }
+        if (i + 1 >= argc) {
+            LOG("Missing value for %s\n", arg.c_str());
+            return false;
+        }
+
+        const char* value = argv[++i];
+        if (arg == "--scene") {
+            options.scene = value;
+        } else if (arg == "--save-scene") {
+            options.saveScene = value;
+        } else if (arg == "--width") {
+            options.width = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--height") {
+            options.height = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--samples") {
+            options.samples = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--time") {
+            options.timeBudget = std::strtof(value, nullptr);
+        } else if (arg == "--noise") {
+            options.noiseThreshold = std::strtof(value, nullptr);
+        } else if (arg == "--convergence") {
+            options.convergence = std::strtof(value, nullptr);
+        } else if (arg == "--bounces") {
+            options.bounces = std::atoi(value);
+        } else if (arg == "--roulette") {
+            options.rouletteDepth = std::string(value) == "off" ? -1 : std::atoi(value);
+        } else if (arg == "--light-sampling") {
+            std::string name = value;
+            if (name == "on") {
+                options.sampleLights = true;
+            } else if (name == "off") {
+                options.sampleLights = false;
+            } else {
+                LOG("Expected on or off for --light-sampling, got %s\n", value);
+                return false;
+            }
+        } else if (arg == "--denoise") {
+            std::string name = value;
+            if (name == "on") {
+                options.denoise = true;
+            } else if (name == "off") {
+                options.denoise = false;
+            } else {
+                LOG("Expected on or off for --denoise, got %s\n", value);
+                return false;
+            }
+        } else if (arg == "--threads") {
+            options.threads = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--integrator") {
+            std::string name = value;
+            if (name == "megakernel") {
+                options.integrator = RT::Integrator::Megakernel;
+            } else if (name == "wavefront") {
+                options.integrator = RT::Integrator::Wavefront;
+            } else {
+                LOG("Unknown integrator %s\n", value);
+                return false;
+            }
+        } else if (arg == "--accumulation") {
+            std::string name = value;
+            if (name == "half") {
+                options.accumulation = RT::AccumulationPrecision::Half;
+            } else if (name == "float") {
+                options.accumulation = RT::AccumulationPrecision::Float;
+            } else if (name == "double") {
+                options.accumulation = RT::AccumulationPrecision::Double;
+            } else {
+                LOG("Unknown accumulation precision %s\n", value);
+                return false;
+            }
+        } else if (arg == "--sampler") {
+            std::string name = value;
+            if (name == "sobol") {
+                options.sampler = RT::SamplerType::Sobol;
+            } else if (name == "bluenoise") {
+                options.sampler = RT::SamplerType::BlueNoise;
+            } else if (name == "pcg") {
+                options.sampler = RT::SamplerType::PCG;
+            } else {
+                LOG("Unknown sampler %s\n", value);
+                return false;
+            }
+        } else if (arg == "--tonemapper") {
+            std::string name = value;
+            if (name == "uncharted2") {
+                options.toneMapper = RT::ToneMapper::Uncharted2;
+            } else if (name == "aces") {
+                options.toneMapper = RT::ToneMapper::ACES;
+            } else if (name == "reinhard") {
+                options.toneMapper = RT::ToneMapper::Reinhard;
+            } else {
+                LOG("Unknown tone mapper %s\n", value);
+                return false;
+            }
+        } else if (arg == "--output") {
+            options.output = value;
+        } else if (arg == "--camera-rays") {
+            std::string name = value;
+            if (name == "analytic") {
+                options.rayGeneration = Core::Camera::RayGeneration::Analytic;
+            } else if (name == "cached") {
+                options.rayGeneration = Core::Camera::RayGeneration::Cached;
+            } else {
+                LOG("Unknown camera ray mode %s\n", value);
+                return false;
+            }
+        } else if (arg == "--trace") {
+            options.trace = value;
+        } else {
+            LOG("Unknown option %s\n", arg.c_str());
+            return false;
+        }
+    }
+
+    if (options.width == 0 || options.height == 0) {
+        LOG("Image size must not be zero\n");
+        return false;
+    }
+    if (options.samples == 0 && options.timeBudget <= 0.0f && options.noiseThreshold <= 0.0f)
+        options.samples = 64;
+    // ImagePNG::Save adds the extension itself
+    if (options.output.size() > 4 && options.output.compare(options.output.size() - 4, 4, ".png") == 0)
+        options.output.resize(options.output.size() - 4);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage(argv[0]);
+        return -1;
+    }
+
+    Core::Scene scene = Core::CreateDefaultScene();
+    Core::CameraSettings cameraSettings;
+    if (!options.scene.empty()) {
+        auto loadStart = std::chrono::steady_clock::now();
+        if (!Core::LoadScene(options.scene, scene, cameraSettings)) {
+            LOG("Failed to load scene %s\n", options.scene.c_str());
+            return -1;
+        }
+        double loadTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+        LOG("Loaded %s (%zu spheres) in %.2f ms\n", options.scene.c_str(), scene.spheres.size(), loadTime);
+    }
+
+    if (!options.saveScene.empty()) {
+        if (!Core::SaveScene(options.saveScene, scene, cameraSettings)) {
+            LOG("Failed to save scene %s\n", options.saveScene.c_str());
+            return -1;
+        }
+        LOG("Saved %s\n", options.saveScene.c_str());
+        return 0;
+    }
+
+    std::unique_ptr<Core::Image> image = std::make_unique<Core::Image>(options.width, options.height, 4);
+    Core::Camera camera(cameraSettings.position, glm::vec2(1), cameraSettings.fov, cameraSettings.nearClip, cameraSettings.farClip);
+    camera.SetRayGeneration(options.rayGeneration);
+    camera.OnResize({static_cast<float>(image->width), static_cast<float>(image->height)});
+
+    RT::Renderer renderer(scene);
+    renderer.settings.bounceLimit = options.bounces;
+    renderer.settings.russianRoulette = options.rouletteDepth >= 0;
+    renderer.settings.russianRouletteDepth = std::max(options.rouletteDepth, 0);
+    renderer.settings.sampleLights = options.sampleLights;
+    renderer.settings.denoise = options.denoise;
+    renderer.SetThreadCount(options.threads);
+    renderer.settings.integrator = options.integrator;
+    renderer.settings.accumulation = options.accumulation;
+    renderer.settings.sampler = options.sampler;
+    renderer.settings.toneMapper = options.toneMapper;
+    // Only the final image gets written, so the display transform runs once at the end instead of every frame
+    renderer.settings.resolveEveryFrame = false;
+    renderer.settings.adaptiveSampling = options.noiseThreshold > 0.0f;
+    renderer.settings.noiseThreshold = options.noiseThreshold;
+    renderer.settings.convergenceTarget = options.convergence;
+    renderer.settings.captureTrace = !options.trace.empty();
+    renderer.OnResize(image->width, image->height);
+
+    LOG("Rendering %ux%u with %u threads\n", image->width, image->height, renderer.GetThreadCount());
+
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point startTime = Clock::now();
+    double elapsed = 0.0;
+    uint32_t frame = 1;
+    // Adaptive sampling gives the pixels that are still noisy several samples a frame, so frames don't count samples
+    uint64_t sampleBudget = static_cast<uint64_t>(options.samples) * image->width * image->height;
+    RT::RenderStats totals;
+    while (true) {
+        renderer.Render(camera, image.get(), frame);
+        const RT::RenderStats& stats = renderer.GetStats();
+        totals.primaryRays += stats.primaryRays;
+        totals.secondaryRays += stats.secondaryRays;
+        totals.shadowRays += stats.shadowRays;
+        totals.intersectionTests += stats.intersectionTests;
+        totals.bvhNodeVisits += stats.bvhNodeVisits;
+        totals.threadBusyMs.resize(stats.threadBusyMs.size());
+        totals.threadIdleMs.resize(stats.threadIdleMs.size());
+        for (size_t i = 0; i < stats.threadBusyMs.size(); i++) {
+            totals.threadBusyMs[i] += stats.threadBusyMs[i];
+            totals.threadIdleMs[i] += stats.threadIdleMs[i];
+        }
+        elapsed = std::chrono::duration<double>(Clock::now() - startTime).count();
+
+        if (options.samples > 0 && renderer.GetSamplesTaken() >= sampleBudget)
+            break;
+        if (options.timeBudget > 0.0f && elapsed >= options.timeBudget)
+            break;
+        if (renderer.IsConverged())
+            break;
+        frame++;
+    }
+
+    renderer.Resolve(image.get());
+    Core::ImagePNG png(image.get());
+    bool saved = png.Save(options.output);
+
+    uint64_t rays = renderer.GetRaysTraced();
+    double pixelSamples = static_cast<double>(renderer.GetSamplesTaken());
+    LOG("Frames: %u\n", frame);
+    LOG("Samples per pixel: %.1f\n", pixelSamples / (static_cast<double>(image->width) * image->height));
+    if (renderer.settings.adaptiveSampling)
+        LOG("Converged pixels: %.2f %%\n", renderer.GetConvergence() * 100.0f);
+    LOG("Wall time: %.3f s\n", elapsed);
+    LOG("Rays traced: %llu\n", static_cast<unsigned long long>(rays));
+    LOG("Rays/sec: %.2f M\n", rays / elapsed / 1e6);
+    LOG("Samples/sec: %.2f M\n", pixelSamples / elapsed / 1e6);
+    LOG("Primary rays: %llu, secondary rays: %llu, shadow rays: %llu\n", static_cast<unsigned long long>(totals.primaryRays),
+        static_cast<unsigned long long>(totals.secondaryRays), static_cast<unsigned long long>(totals.shadowRays));
+    LOG("Intersection tests: %llu, BVH node visits: %llu\n", static_cast<unsigned long long>(totals.intersectionTests),
+        static_cast<unsigned long long>(totals.bvhNodeVisits));
+    for (size_t i = 0; i < totals.threadBusyMs.size(); i++)
+        LOG("Thread %zu: busy %.1f ms, idle %.1f ms\n", i, totals.threadBusyMs[i], totals.threadIdleMs[i]);
+    if (!options.trace.empty() && renderer.SaveTrace(options.trace))
+        LOG("Saved trace %s\n", options.trace.c_str());
+    // ImagePNG::Save already reported why
+    if (!saved)
+        return -1;
+    LOG("Saved %s.png\n", options.output.c_str());
+    return 0;
+}
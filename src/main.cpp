@@ -1,10 +1,14 @@
 #include <string>
 #include <memory>
+#include <thread>
+#include <algorithm>
 
 #include <Renderer.h>
+#include <RenderThread.h>
 #include <Camera.h>
 #include <Image.h>
 #include <ImageFile.h>
+#include <SceneFile.h>
 
 #include <glad/glad.h>
 #include <imgui.h>
@@ -22,20 +26,28 @@
 #include <VertexArray.h>
 #include <Shader.h>
 #include <Texture2D.h>
+#include <StreamingTexture.h>
 
 #define LOG(x, ...) printf(x, ##__VA_ARGS__) // Temporary, maybe I'll create a logging library for performance measurements
 
 #define IMGUI_UNLIMITED_FRAME_RATE
 
-int main() {
+int main(int argc, char** argv) {
     if (!glfwInit()) {
         LOG("Failed to initialize GLFW\n");
         return -1;
     }
 
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
-    GLFWwindow* window = glfwCreateWindow(1280, 720, "RayTracing", nullptr, nullptr);
+    // Software implementations like llvmpipe may not offer 4.6, fall back to older contexts before giving up
+    const int glVersions[][2] = { {4, 6}, {4, 5}, {3, 3} };
+    GLFWwindow* window = nullptr;
+    for (const auto& version : glVersions) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, version[0]);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, version[1]);
+        window = glfwCreateWindow(1280, 720, "RayTracing", nullptr, nullptr);
+        if (window)
+            break;
+    }
     if (!window) {
         LOG("Failed to create GLFW window\n");
         glfwTerminate();
@@ -61,48 +73,40 @@ int main() {
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 130");
 
-    GLuint renderTexture;
-    glGenTextures(1, &renderTexture);
-    glBindTexture(GL_TEXTURE_2D, renderTexture);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    
     RT::Shader RTShader = RT::Shader("resources/shaders/raytracing.glsl");
 
-    Core::Scene scene;
-    scene.materials.push_back({glm::vec3(124.0f/255.0f, 252.0f/255.0f, 0.0f)});
-    scene.materials.push_back({glm::vec3(1.0f, 46.0f/255.0f, 0.0f), glm::vec3(0.0f, 191.0f/255.0f, 21.0f/255.0f), 20.0f});
-    scene.materials.push_back({glm::vec3(204.0f/255.0f, 128.0f/255.0f, 51.0f/255.0f)});
-
-    {
-        Core::Sphere sphere;
-        sphere.position = glm::vec3(0.0f, -100.5f, 0.0f);
-        sphere.radius = 100.0f;
-        sphere.materialIndex = 0;
-        scene.spheres.push_back(sphere);
-    }
-    {
-        Core::Sphere sphere;
-        sphere.position = glm::vec3(33.0f, 4.0f, -32.0f);
-        sphere.radius = 20.0f;
-        sphere.materialIndex = 1;
-        scene.spheres.push_back(sphere);
-    }
-    {
-        Core::Sphere sphere;
-        sphere.materialIndex = 2;
-        scene.spheres.push_back(sphere);
+    Core::Scene scene = Core::CreateDefaultScene();
+    Core::CameraSettings cameraSettings;
+    if (argc > 1 && !Core::LoadScene(argv[1], scene, cameraSettings)) {
+        LOG("Failed to load scene %s, using the default scene\n", argv[1]);
+        scene = Core::CreateDefaultScene();
+        cameraSettings = {};
     }
 
     glm::vec2 viewport(1);
-    std::unique_ptr<Core::Image> image = std::make_unique<Core::Image>(1920, 1080, 4);
-    Core::Camera camera(glm::vec3(0, 0, 3), viewport, 45.0f, 0.1f, 1000.0f);
-    RT::Renderer renderer(scene);
-
-    uint32_t frame = 1;
+    Core::Camera camera(cameraSettings.position, viewport, cameraSettings.fov, cameraSettings.nearClip, cameraSettings.farClip);
+    RT::RenderThread renderThread(scene, camera);
+    // Meshes and instances can't be edited, so only the render thread's copy of them is kept
+    uint64_t triangleCount = 0;
+    for (const Core::Mesh& mesh : scene.meshes)
+        triangleCount += mesh.GetTriangleCount();
+    size_t instanceCount = scene.instances.size();
+    scene.meshes = {};
+    scene.instances = {};
+    RT::StreamingTexture renderTexture;
+    std::vector<Core::ImageRegion> changedTiles;
+    uint64_t uploadedVersion = 0;
+
+    // UI side copies of what the render thread owns, changes are sent over as commands
+    RT::RenderSettings settings;
+    int threadCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
     bool accumulate = false;
+    uint32_t viewportWidth = 0, viewportHeight = 0;
+    const RT::RenderedFrame* renderedFrame = nullptr;
+
     uint32_t framesAccToSave = 1000;
     uint32_t pngImageCount = 0;
+    bool convergedImageSaved = false;
     
     while (!glfwWindowShouldClose(window)) {
         glfwPollEvents();
@@ -115,68 +119,211 @@ int main() {
         ImGui::Begin("RayTracing Viewport");
         uint32_t width = static_cast<uint32_t>(ImGui::GetContentRegionAvail().x);
         uint32_t height = static_cast<uint32_t>(ImGui::GetContentRegionAvail().y);
-        if (width != image->width || height != image->height) {
-            image.reset(new Core::Image(width, height, 4));
-            camera.OnResize({image->width, image->height});
-            renderer.OnResize(image->width, image->height);
-            frame = 1;
+        if (width != viewportWidth || height != viewportHeight) {
+            renderThread.Resize(width, height);
+            viewportWidth = width;
+            viewportHeight = height;
         }
 
-        float startTime = static_cast<float>(glfwGetTime());
-        renderer.Render(camera, image.get(), frame);
-        if (accumulate)
-            frame++;
-        if (frame == framesAccToSave) {
-            Core::ImagePNG png(image.get());
-            png.Save("resources/out/output" + std::to_string(pngImageCount));
+        // The UI never waits for the renderer, it shows the newest frame that finished
+        if (const RT::RenderedFrame* latest = renderThread.AcquireFrame()) {
+            renderedFrame = latest;
+            const Core::Image* image = renderedFrame->image.get();
+            changedTiles.clear();
+            for (size_t i = 0; i < renderedFrame->tiles.size(); i++) {
+                if (renderedFrame->tileVersions[i] > uploadedVersion)
+                    changedTiles.push_back(renderedFrame->tiles[i]);
+            }
+            renderTexture.Upload(*image, changedTiles);
+            uploadedVersion = renderedFrame->version;
+
+            if (renderedFrame->frame == 1)
+                convergedImageSaved = false;
+            // With adaptive sampling the render is done once it converged instead of after a fixed frame count
+            if (settings.adaptiveSampling ? (accumulate && renderedFrame->converged && !convergedImageSaved) : renderedFrame->frame == framesAccToSave) {
+                Core::ImagePNG png(image);
+                png.Save("resources/out/output" + std::to_string(pngImageCount));
+                convergedImageSaved = true;
+            }
         }
 
-        float endTime = static_cast<float>(glfwGetTime());
-        float deltaTime = (endTime - startTime) * 1000;
-        int frameRate = static_cast<int>(1.0f / (endTime - startTime));
-
-        ImGui::Image(renderTexture, ImVec2(static_cast<float>(image->width), static_cast<float>(image->height)), ImVec2(0, 1), ImVec2(1, 0));
+        if (renderedFrame)
+            ImGui::Image(renderTexture.GetID(), ImVec2(static_cast<float>(renderedFrame->image->width), static_cast<float>(renderedFrame->image->height)), ImVec2(0, 1), ImVec2(1, 0));
         ImGui::End();
 
         ImGui::Begin("RayTracing Options");
         
-        ImGui::Text("Delta Time: %f", deltaTime);
-        ImGui::Text("Frame Rate: %i", frameRate);
-        ImGui::Text("Render Resolution: %ix%i", static_cast<int>(image->width), static_cast<int>(image->height));
+        ImGui::Text("UI Frame Time: %f", io.DeltaTime * 1000.0f);
+        ImGui::Text("UI Frame Rate: %i", static_cast<int>(io.Framerate));
+        if (renderedFrame) {
+            ImGui::Text("Render Resolution: %ix%i", static_cast<int>(renderedFrame->image->width), static_cast<int>(renderedFrame->image->height));
+            ImGui::Text("Frames Accumulated: %i", static_cast<int>(renderedFrame->frame));
+        }
         ImGui::Text("Spheres Count: %i", static_cast<int>(scene.spheres.size()));
-        ImGui::Text("Frames Accumulated: %i", static_cast<int>(frame));
-        ImGui::Text("Frames Accumulated to Save: %i", static_cast<int>(framesAccToSave));
+        ImGui::Text("Triangle Count: %llu", static_cast<unsigned long long>(triangleCount));
+        ImGui::Text("Instance Count: %zu", instanceCount);
+        if (settings.adaptiveSampling)
+            ImGui::Text("Converged Pixels: %.2f%%", renderedFrame ? renderedFrame->convergence * 100.0f : 0.0f);
+        else
+            ImGui::Text("Frames Accumulated to Save: %i", static_cast<int>(framesAccToSave));
         
         ImGui::Separator();
         
-        ImGui::SliderInt("Max Bounces", &renderer.bounceLimit, 1, 8);
-        ImGui::DragFloat("Gamma Correction", &renderer.gamma, 0.1f);
-        ImGui::DragFloat("Exposure", &renderer.exposure, 0.1f);
+        bool settingsChanged = false;
+        bool restart = false;
+        settingsChanged |= ImGui::SliderInt("Max Bounces", &settings.bounceLimit, 1, 64);
+        settingsChanged |= ImGui::Checkbox("Russian Roulette", &settings.russianRoulette);
+        if (settings.russianRoulette)
+            settingsChanged |= ImGui::SliderInt("Roulette Depth", &settings.russianRouletteDepth, 1, 16);
+        settingsChanged |= ImGui::Checkbox("Light Sampling", &settings.sampleLights);
+        const char* integrators[] = { "Megakernel", "Wavefront" };
+        int integrator = static_cast<int>(settings.integrator);
+        if (ImGui::Combo("Integrator", &integrator, integrators, IM_ARRAYSIZE(integrators))) {
+            settings.integrator = static_cast<RT::Integrator>(integrator);
+            settingsChanged = true;
+        }
+        int maxThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+        if (ImGui::SliderInt("Render Threads", &threadCount, 1, maxThreads)) {
+            renderThread.Submit([count = static_cast<uint32_t>(threadCount)](RT::RenderThread::Context& ctx) {
+                ctx.renderer.SetThreadCount(count);
+            });
+        }
+        const char* precisions[] = { "Half", "Float", "Double" };
+        int precision = static_cast<int>(settings.accumulation);
+        if (ImGui::Combo("Accumulation", &precision, precisions, IM_ARRAYSIZE(precisions))) {
+            settings.accumulation = static_cast<RT::AccumulationPrecision>(precision);
+            restart = true;
+        }
+        const char* samplers[] = { "Sobol", "Blue Noise", "PCG" };
+        int sampler = static_cast<int>(settings.sampler);
+        if (ImGui::Combo("Sampler", &sampler, samplers, IM_ARRAYSIZE(samplers))) {
+            settings.sampler = static_cast<RT::SamplerType>(sampler);
+            restart = true;
+        }
+        settingsChanged |= ImGui::DragFloat("Gamma Correction", &settings.gamma, 0.1f);
+        settingsChanged |= ImGui::DragFloat("Exposure", &settings.exposure, 0.1f);
         
-        if (ImGui::Checkbox("Apply Gamma Correction", &renderer.doGammaCorrection))
-            frame = 1;
-        if (ImGui::Checkbox("Apply ToneMapping", &renderer.doToneMapping))
-            frame = 1;
-        if (ImGui::Checkbox("Accumulate", &accumulate))
-            frame = 1;
-        if (ImGui::Button("Reset Accumulated Data"))
-            frame = 1;
+        settingsChanged |= ImGui::Checkbox("Interactive Preview", &settings.interactivePreview);
+        settingsChanged |= ImGui::DragFloat("Target Frame Time (ms)", &settings.targetFrameTimeMs, 0.5f, 0.0f, 1000.0f, settings.targetFrameTimeMs > 0.0f ? "%.1f" : "Off");
+        restart |= ImGui::Checkbox("Apply Gamma Correction", &settings.doGammaCorrection);
+        restart |= ImGui::Checkbox("Apply ToneMapping", &settings.doToneMapping);
+        const char* toneMappers[] = { "Uncharted 2", "ACES", "Reinhard" };
+        int toneMapper = static_cast<int>(settings.toneMapper);
+        if (ImGui::Combo("Tone Mapper", &toneMapper, toneMappers, IM_ARRAYSIZE(toneMappers))) {
+            settings.toneMapper = static_cast<RT::ToneMapper>(toneMapper);
+            settingsChanged = true;
+        }
+        settingsChanged |= ImGui::Checkbox("Temporal Reprojection", &settings.temporalReprojection);
+        if (settings.temporalReprojection) {
+            int maxSamples = static_cast<int>(settings.reprojectionMaxSamples);
+            if (ImGui::SliderInt("History Samples", &maxSamples, 1, 256)) {
+                settings.reprojectionMaxSamples = static_cast<uint32_t>(maxSamples);
+                settingsChanged = true;
+            }
+        }
+        settingsChanged |= ImGui::Checkbox("Denoise", &settings.denoise);
+        if (settings.denoise)
+            settingsChanged |= ImGui::SliderInt("Denoise Iterations", &settings.denoiser.iterations, 1, 8);
+        if (ImGui::Checkbox("Accumulate", &accumulate)) {
+            renderThread.Submit([accumulate](RT::RenderThread::Context& ctx) {
+                ctx.accumulate = accumulate;
+                ctx.restart = true;
+            });
+        }
+        restart |= ImGui::Checkbox("Adaptive Sampling", &settings.adaptiveSampling);
+        if (settings.adaptiveSampling) {
+            settingsChanged |= ImGui::DragFloat("Noise Threshold", &settings.noiseThreshold, 0.001f, 0.0001f, 1.0f, "%.4f");
+            settingsChanged |= ImGui::SliderFloat("Convergence Target", &settings.convergenceTarget, 0.5f, 1.0f);
+        }
+        restart |= ImGui::Button("Reset Accumulated Data");
         
         ImGui::End();
 
+        ImGui::Begin("Render Stats");
+        if (renderedFrame) {
+            const RT::RenderStats& stats = renderedFrame->stats;
+            ImGui::Text("Render Time: %.2f ms", stats.frameTimeMs);
+            ImGui::Text("Rays/sec: %.2f M", stats.GetRaysPerSecond() / 1e6);
+            ImGui::Text("Primary Rays: %llu", static_cast<unsigned long long>(stats.primaryRays));
+            ImGui::Text("Secondary Rays: %llu", static_cast<unsigned long long>(stats.secondaryRays));
+            ImGui::Text("Shadow Rays: %llu", static_cast<unsigned long long>(stats.shadowRays));
+            ImGui::Text("Intersection Tests: %llu", static_cast<unsigned long long>(stats.intersectionTests));
+            ImGui::Text("BVH Node Visits: %llu", static_cast<unsigned long long>(stats.bvhNodeVisits));
+            ImGui::Text("Samples per Pixel: %u, Tiles: %u", stats.samplesPerPixel, stats.tilesRendered);
+            ImGui::Text("Tile Time: %.3f / %.3f / %.3f ms (min/avg/max)", stats.minTileTimeMs, stats.avgTileTimeMs, stats.maxTileTimeMs);
+            if (stats.reprojectedPixels > 0)
+                ImGui::Text("Reprojected: %u pixels in %.2f ms", stats.reprojectedPixels, stats.reprojectTimeMs);
+            if (stats.resolveTimeMs > 0.0)
+                ImGui::Text("Denoise + Resolve: %.2f ms (%s)", stats.resolveTimeMs, RT::Denoiser::GetKernelName());
+            if (ImGui::CollapsingHeader("Threads")) {
+                for (size_t i = 0; i < stats.threadBusyMs.size(); i++) {
+                    float busy = stats.frameTimeMs > 0.0 ? static_cast<float>(stats.threadBusyMs[i] / stats.frameTimeMs) : 0.0f;
+                    ImGui::Text("Thread %zu: busy %.2f ms, idle %.2f ms", i, stats.threadBusyMs[i], stats.threadIdleMs[i]);
+                    ImGui::ProgressBar(std::min(busy, 1.0f), ImVec2(-1, 0));
+                }
+            }
+        }
+        ImGui::Separator();
+        settingsChanged |= ImGui::Checkbox("Capture Trace", &settings.captureTrace);
+        ImGui::SameLine();
+        if (ImGui::Button("Save Trace"))
+            renderThread.Submit([](RT::RenderThread::Context& ctx) { ctx.renderer.SaveTrace("resources/out/trace.json"); });
+        ImGui::SameLine();
+        if (ImGui::Button("Clear Trace"))
+            renderThread.Submit([](RT::RenderThread::Context& ctx) { ctx.renderer.ClearTrace(); });
+        ImGui::End();
+
+        if (settingsChanged || restart) {
+            renderThread.Submit([settings, restart](RT::RenderThread::Context& ctx) {
+                ctx.renderer.settings = settings;
+                ctx.restart |= restart;
+            });
+        }
+
+        ImGui::Begin("Camera");
+        glm::vec3 cameraPosition = camera.GetPosition();
+        if (ImGui::DragFloat3("Position", glm::value_ptr(cameraPosition), 0.1f)) {
+            camera.SetPosition(cameraPosition);
+            renderThread.Submit([cameraPosition](RT::RenderThread::Context& ctx) {
+                ctx.camera.SetPosition(cameraPosition);
+                // The renderer notices the move and reprojects its samples itself
+                ctx.restart |= !ctx.renderer.settings.temporalReprojection;
+            });
+        }
+        const char* rayGenerations[] = { "Cached", "Analytic" };
+        int rayGeneration = static_cast<int>(camera.GetRayGeneration());
+        if (ImGui::Combo("Primary Rays", &rayGeneration, rayGenerations, IM_ARRAYSIZE(rayGenerations))) {
+            camera.SetRayGeneration(static_cast<Core::Camera::RayGeneration>(rayGeneration));
+            renderThread.Submit([rayGeneration](RT::RenderThread::Context& ctx) {
+                ctx.camera.SetRayGeneration(static_cast<Core::Camera::RayGeneration>(rayGeneration));
+                ctx.restart = true;
+            });
+        }
+        if (ImGui::Checkbox("Anti-Aliasing", &settings.jitterPrimaryRays)) {
+            renderThread.Submit([jitter = settings.jitterPrimaryRays](RT::RenderThread::Context& ctx) {
+                ctx.renderer.settings.jitterPrimaryRays = jitter;
+                ctx.restart = true;
+            });
+        }
+        ImGui::End();
+
         ImGui::Begin("Scene");
+        bool sceneEdited = false;
         if (ImGui::CollapsingHeader("SkyLight")) {
-            ImGui::ColorEdit3("Albedo", glm::value_ptr(scene.skyLight.color));
-            ImGui::DragFloat("Strength", &scene.skyLight.strength, 0.1f);
+            sceneEdited |= ImGui::ColorEdit3("Albedo", glm::value_ptr(scene.skyLight.color));
+            sceneEdited |= ImGui::DragFloat("Strength", &scene.skyLight.strength, 0.1f);
         }
         if (ImGui::CollapsingHeader("Spheres")) {
             for (size_t i = 0; i < scene.spheres.size(); i++) {
                 ImGui::PushID(("Sphere" + std::to_string(i)).c_str());
-                ImGui::DragFloat3("Position", glm::value_ptr(scene.spheres[i].position), 0.1f);
-                ImGui::DragFloat("Scale", &scene.spheres[i].radius, 0.1f);
-                ImGui::InputInt("Material ID", &scene.spheres[i].materialIndex);
+                bool sphereChanged = ImGui::DragFloat3("Position", glm::value_ptr(scene.spheres[i].position), 0.1f);
+                sphereChanged |= ImGui::DragFloat("Scale", &scene.spheres[i].radius, 0.1f);
+                sphereChanged |= ImGui::InputInt("Material ID", &scene.spheres[i].materialIndex);
+                if (sphereChanged)
+                    scene.MarkSphereDirty(static_cast<uint32_t>(i));
                 if (ImGui::Button("Remove")) {
                     scene.spheres.erase(scene.spheres.begin() + static_cast<uint32_t>(i));
+                    scene.MarkSpheresAddedOrRemoved();
                 }
                 if (i != scene.spheres.size() - 1) {
                     ImGui::Separator();
@@ -187,19 +334,46 @@ int main() {
             ImGui::PushID("Sphere Add");
             if (ImGui::Button("Add")) {
                 scene.spheres.push_back({});
+                scene.MarkSpheresAddedOrRemoved();
             }
             ImGui::PopID();
         }
+        if (scene.HasDirtySpheres()) {
+            // Send over only the spheres that changed unless the list itself did
+            if (scene.spheresAddedOrRemoved) {
+                renderThread.Submit([spheres = scene.spheres](RT::RenderThread::Context& ctx) {
+                    ctx.scene.spheres = spheres;
+                    ctx.scene.MarkSpheresAddedOrRemoved();
+                });
+            } else {
+                std::vector<std::pair<uint32_t, Core::Sphere>> edits;
+                for (uint32_t index : scene.dirtySpheres)
+                    edits.emplace_back(index, scene.spheres[index]);
+                renderThread.Submit([edits = std::move(edits)](RT::RenderThread::Context& ctx) {
+                    for (const auto& [index, sphere] : edits) {
+                        ctx.scene.spheres[index] = sphere;
+                        ctx.scene.MarkSphereDirty(index);
+                    }
+                });
+            }
+            renderThread.Submit([](RT::RenderThread::Context& ctx) {
+                ctx.renderer.UpdateAccelerationStructure();
+                ctx.scene.ClearDirty();
+            });
+            scene.ClearDirty();
+            sceneEdited = true;
+        }
 
         if (ImGui::CollapsingHeader("Materials")) {
             for (size_t i = 0; i < scene.materials.size(); i++) {
                 ImGui::PushID(("Material" + std::to_string(i)).c_str());
-                ImGui::ColorEdit3("Albedo", glm::value_ptr(scene.materials[i].albedo));
-                ImGui::ColorEdit3("Emission Color", glm::value_ptr(scene.materials[i].emissionColor));
-                ImGui::DragFloat("Emission Strength", &scene.materials[i].emissionStrength, 1);
-                ImGui::SliderFloat("Shininess", &scene.materials[i].shininess, 0, 1);
+                sceneEdited |= ImGui::ColorEdit3("Albedo", glm::value_ptr(scene.materials[i].albedo));
+                sceneEdited |= ImGui::ColorEdit3("Emission Color", glm::value_ptr(scene.materials[i].emissionColor));
+                sceneEdited |= ImGui::DragFloat("Emission Strength", &scene.materials[i].emissionStrength, 1);
+                sceneEdited |= ImGui::SliderFloat("Shininess", &scene.materials[i].shininess, 0, 1);
                 if (ImGui::Button("Remove")) {
                     scene.materials.erase(scene.materials.begin() + static_cast<uint32_t>(i));
+                    sceneEdited = true;
                 }
                 if (i != scene.materials.size() - 1) {
                     ImGui::Separator();
@@ -210,14 +384,21 @@ int main() {
             ImGui::PushID("Material Add");
             if (ImGui::Button("Add")) {
                 scene.materials.push_back({});
+                sceneEdited = true;
             }
             ImGui::PopID();
         }
+        if (sceneEdited) {
+            renderThread.Submit([skyLight = scene.skyLight, materials = scene.materials](RT::RenderThread::Context& ctx) {
+                ctx.scene.skyLight = skyLight;
+                ctx.scene.materials = materials;
+                ctx.restart = true;
+            });
+        }
         ImGui::End();
 
 
         ImGui::Render();
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, static_cast<int>(image->width), static_cast<int>(image->height), 0, GL_RGBA, GL_UNSIGNED_BYTE, image->pixels.data());
         glViewport(0, 0, static_cast<int>(io.DisplaySize.x), static_cast<int>(io.DisplaySize.y));
         glClearColor(0.45f, 0.55f, 0.60f, 1.00f);
         glClear(GL_COLOR_BUFFER_BIT);
@@ -226,6 +407,7 @@ int main() {
         glfwSwapBuffers(window);
     }
 
+    renderTexture.Release();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();